@@ -19,6 +19,11 @@ nowebengine {
   QT += webenginewidgets
 }
 
+# Counts heap allocations for comparing updates, see src/allocationstats.h
+alloc_stats {
+  DEFINES += ALLOCATION_STATS
+}
+
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 include(deps/QsLog/QsLog.pri)
@@ -27,10 +32,12 @@ INCLUDEPATH += src deps deps/boost-header-only
 
 SOURCES += \
     deps/sqlite/sqlite3.c \
+    src/allocationstats.cpp \
     src/application.cpp \
     src/autoonline.cpp \
     src/bucket.cpp \
     src/buyoutmanager.cpp \
+    src/cachestatsdialog.cpp \
     src/column.cpp \
     src/currencymanager.cpp \
     src/sqlitedatastore.cpp \
@@ -38,11 +45,15 @@ SOURCES += \
     src/filters.cpp \
     src/flowlayout.cpp \
     src/imagecache.cpp \
+    src/internedstring.cpp \
     src/item.cpp \
+    src/itemarena.cpp \
+    src/itemhash.cpp \
     src/itemlocation.cpp \
     src/items_model.cpp \
     src/itemsmanager.cpp \
     src/itemsmanagerworker.cpp \
+    src/itemstore.cpp \
     src/itemtooltip.cpp \
     src/logindialog.cpp \
     src/logpanel.cpp \
@@ -51,29 +62,40 @@ SOURCES += \
     src/memorydatastore.cpp \
     src/modlist.cpp \
     src/modsfilter.cpp \
+    src/networkcapture.cpp \
     src/porting.cpp \
+    src/ratelimiter.cpp \
     src/replytimeout.cpp \
     src/search.cpp \
     src/shop.cpp \
+    src/stashreplyreader.cpp \
     src/steamlogindialog.cpp \
     src/tabcache.cpp \
+    src/tabparser.cpp \
     src/updatechecker.cpp \
     src/util.cpp \
     src/version.cpp \
     src/verticalscrollarea.cpp \
+    test/mockpoeserver.cpp \
     test/testdata.cpp \
+    test/testendtoend.cpp \
     test/testitem.cpp \
     test/testitemsmanager.cpp \
     test/testmain.cpp \
+    test/testratelimiter.cpp \
     test/testshop.cpp \
+    test/teststashreplyreader.cpp \
+    test/testtabcache.cpp \
     test/testutil.cpp
 
 HEADERS += \
     deps/sqlite/sqlite3.h \
+    src/allocationstats.h \
     src/application.h \
     src/autoonline.h \
     src/bucket.h \
     src/buyoutmanager.h \
+    src/cachestatsdialog.h \
     src/column.h \
     src/currencymanager.h \
     src/datastore.h \
@@ -82,12 +104,17 @@ HEADERS += \
     src/filters.h \
     src/flowlayout.h \
     src/imagecache.h \
+    src/internedstring.h \
     src/item.h \
+    src/itemarena.h \
     src/itemconstants.h \
+    src/itemhash.h \
+    src/itemjson.h \
     src/itemlocation.h \
     src/items_model.h \
     src/itemsmanager.h \
     src/itemsmanagerworker.h \
+    src/itemstore.h \
     src/itemtooltip.h \
     src/logindialog.h \
     src/logpanel.h \
@@ -95,24 +122,33 @@ HEADERS += \
     src/memorydatastore.h \
     src/modlist.h \
     src/modsfilter.h \
+    src/networkcapture.h \
     src/porting.h \
     src/rapidjson_util.h \
+    src/ratelimiter.h \
     src/replytimeout.h \
     src/search.h \
     src/selfdestructingreply.h \
     src/shop.h \
+    src/stashreplyreader.h \
     src/steamlogindialog.h \
     src/tabcache.h \
+    src/tabparser.h \
     src/updatechecker.h \
     src/util.h \
     src/version.h \
     src/version_defines.h \
     src/verticalscrollarea.h \
+    test/mockpoeserver.h \
     test/testdata.h \
+    test/testendtoend.h \
     test/testitem.h \
     test/testitemsmanager.h \
     test/testmain.h \
+    test/testratelimiter.h \
     test/testshop.h \
+    test/teststashreplyreader.h \
+    test/testtabcache.h \
     test/testutil.h
 
 FORMS += \
@@ -0,0 +1,78 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "allocationstats.h"
+
+#ifdef ALLOCATION_STATS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> allocation_count{0};
+std::atomic<uint64_t> allocation_bytes{0};
+
+void *AllocateNothrow(std::size_t size) noexcept {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void *Allocate(std::size_t size) {
+    if (void *p = AllocateNothrow(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+}
+
+void *operator new(std::size_t size) { return Allocate(size); }
+void *operator new[](std::size_t size) { return Allocate(size); }
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept { return AllocateNothrow(size); }
+void *operator new[](std::size_t size, const std::nothrow_t&) noexcept { return AllocateNothrow(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept { std::free(p); }
+
+bool AllocationStats::Enabled() {
+    return true;
+}
+
+AllocationStats AllocationStats::Current() {
+    AllocationStats stats;
+    stats.count = allocation_count.load(std::memory_order_relaxed);
+    stats.bytes = allocation_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+#else
+
+bool AllocationStats::Enabled() {
+    return false;
+}
+
+AllocationStats AllocationStats::Current() {
+    return AllocationStats();
+}
+
+#endif
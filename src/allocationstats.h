@@ -0,0 +1,44 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Heap allocations made through operator new since the start, for comparing how
+ * much an update or loading the stash allocates.  Counting replaces the global
+ * operator new and delete, nothrow forms included, so it's only built in with
+ * CONFIG+=alloc_stats; otherwise Enabled() is false and the counters stay zero.
+ * Counts cover every thread of the process.
+ */
+struct AllocationStats {
+    uint64_t count{0};
+    uint64_t bytes{0};
+
+    static bool Enabled();
+    static AllocationStats Current();
+    AllocationStats operator-(const AllocationStats &other) const {
+        AllocationStats result;
+        result.count = count - other.count;
+        result.bytes = bytes - other.bytes;
+        return result;
+    }
+};
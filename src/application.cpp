@@ -20,12 +20,14 @@
 #include "application.h"
 
 #include <QNetworkAccessManager>
+#include <QNetworkCookieJar>
 
 #include "buyoutmanager.h"
 #include "sqlitedatastore.h"
 #include "memorydatastore.h"
 #include "filesystem.h"
 #include "itemsmanager.h"
+#include "itemsmanagerworker.h"
 #include "currencymanager.h"
 #include "porting.h"
 #include "shop.h"
@@ -43,6 +45,7 @@ void Application::InitLogin(std::unique_ptr<QNetworkAccessManager> login_manager
         bool mock_data) {
     league_ = league;
     email_ = email;
+    mock_data_ = mock_data;
     logged_in_nm_ = std::move(login_manager);
 
     if (mock_data) {
@@ -64,6 +67,17 @@ void Application::InitLogin(std::unique_ptr<QNetworkAccessManager> login_manager
     items_manager_->Update(TabSelection::Checked);
 }
 
+std::unique_ptr<Application> Application::OpenLeague(const std::string &league) const {
+    QUrl poe(ItemsManagerWorker::ApiUrl(""));
+    auto login_manager = std::make_unique<QNetworkAccessManager>();
+    login_manager->cookieJar()->setCookiesFromUrl(logged_in_nm_->cookieJar()->cookiesForUrl(poe), poe);
+
+    QLOG_INFO() << "Opening league" << league.c_str() << "for" << email_.c_str();
+    auto app = std::make_unique<Application>();
+    app->InitLogin(std::move(login_manager), league, email_, mock_data_);
+    return app;
+}
+
 void Application::OnItemsRefreshed(bool initial_refresh) {
     currency_manager_->Update();
     shop_->Update();
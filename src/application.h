@@ -41,6 +41,9 @@ public:
     Application& operator=(const Application&) = delete;
     // Should be called by login dialog after login
     void InitLogin(std::unique_ptr<QNetworkAccessManager> login_manager, const std::string &league, const std::string &email, bool mock_data = false);
+    // Logs into another league of the same account, reusing this session's cookies.  Both
+    // run their own worker and data store but share the account's RateLimiter.
+    std::unique_ptr<Application> OpenLeague(const std::string &league) const;
     const std::string &league() const { return league_; }
     const std::string &email() const { return email_; }
     ItemsManager &items_manager() { return *items_manager_; }
@@ -55,6 +58,7 @@ public slots:
 private:
     std::string league_;
     std::string email_;
+    bool mock_data_{false};
     std::unique_ptr<DataStore> data_;
     // stores sensitive data that you'd rather not share, like control.poe.trade secret URL
     std::unique_ptr<DataStore> sensitive_data_;
@@ -217,7 +217,11 @@ void BuyoutManager::Set(const Item &item, const Buyout &buyout) {
 }
 
 Buyout BuyoutManager::Get(const Item &item) const {
-    auto const it = buyouts_.find(item.hash());
+    return Get(item.hash());
+}
+
+Buyout BuyoutManager::Get(const ItemHash &hash) const {
+    auto const it = buyouts_.find(hash);
     if (it != buyouts_.end()) {
         return it->second;
     }
@@ -268,7 +272,7 @@ void BuyoutManager::CompressItemBuyouts(const Items &items) {
     // When items are moved between tabs or deleted their buyouts entries remain
     // This function looks at buyouts and makes sure there is an associated item
     // that exists
-    std::set<std::string> tmp;
+    std::set<ItemHash> tmp;
     for (auto const &item_sp: items) {
         const Item & item= *item_sp;
         tmp.insert(item.hash());
@@ -316,7 +320,29 @@ void BuyoutManager::Clear() {
     tabs_.clear();
 }
 
-std::string BuyoutManager::Serialize(const std::map<std::string, Buyout> &buyouts) {
+namespace {
+
+const std::string &KeyAsString(const std::string &key) {
+    return key;
+}
+
+std::string KeyAsString(const ItemHash &key) {
+    return key.ToHex();
+}
+
+bool KeyFromString(const std::string &str, std::string *key) {
+    *key = str;
+    return true;
+}
+
+bool KeyFromString(const std::string &str, ItemHash *key) {
+    return ItemHash::FromHex(str, key);
+}
+
+}
+
+template <typename Key>
+std::string BuyoutManager::Serialize(const std::map<Key, Buyout> &buyouts) {
     rapidjson::Document doc;
     doc.SetObject();
     auto &alloc = doc.GetAllocator();
@@ -341,14 +367,15 @@ std::string BuyoutManager::Serialize(const std::map<std::string, Buyout> &buyout
 
         item.AddMember("inherited", buyout.inherited, alloc);
 
-        rapidjson::Value name(bo.first.c_str(), alloc);
+        rapidjson::Value name(KeyAsString(bo.first).c_str(), alloc);
         doc.AddMember(name, item, alloc);
     }
 
     return Util::RapidjsonSerialize(doc);
 }
 
-void BuyoutManager::Deserialize(const std::string &data, std::map<std::string, Buyout> *buyouts) {
+template <typename Key>
+void BuyoutManager::Deserialize(const std::string &data, std::map<Key, Buyout> *buyouts) {
     buyouts->clear();
 
     // if data is empty (on first use) we shouldn't make user panic by showing ERROR messages
@@ -365,7 +392,11 @@ void BuyoutManager::Deserialize(const std::string &data, std::map<std::string, B
         return;
     for (auto itr = doc.MemberBegin(); itr != doc.MemberEnd(); ++itr) {
         auto &object = itr->value;
-        const std::string &name = itr->name.GetString();
+        Key key;
+        if (!KeyFromString(itr->name.GetString(), &key)) {
+            QLOG_WARN() << "Ignoring buyout with malformed key" << itr->name.GetString();
+            continue;
+        }
         Buyout bo;
 
         bo.currency = Currency::FromTag(object["currency"].GetString());
@@ -380,7 +411,7 @@ void BuyoutManager::Deserialize(const std::string &data, std::map<std::string, B
         bo.inherited = false;
         if (object.HasMember("inherited"))
             bo.inherited = object["inherited"].GetBool();
-        (*buyouts)[name] = bo;
+        (*buyouts)[key] = bo;
     }
 }
 
@@ -478,12 +509,13 @@ Buyout BuyoutManager::StringToBuyout(std::string format) {
     return tmp;
 }
 
-void BuyoutManager::MigrateItem(const Item &item) {
-    std::string old_hash = item.old_hash();
-    std::string hash = item.hash();
+void BuyoutManager::MigrateItem(const Item &item, const std::string &legacy_hash) {
+    ItemHash old_hash;
+    if (!ItemHash::FromHex(legacy_hash, &old_hash) || old_hash == item.hash())
+        return;
     auto it = buyouts_.find(old_hash);
     if (it != buyouts_.end()) {
-        buyouts_[hash] = it->second;
+        buyouts_[item.hash()] = it->second;
         buyouts_.erase(it);
         save_needed_ = true;
     }
@@ -148,6 +148,7 @@ public:
     explicit BuyoutManager(DataStore &data);
     void Set(const Item &item, const Buyout &buyout);
     Buyout Get(const Item &item) const;
+    Buyout Get(const ItemHash &hash) const;
 
     void SetTab(const std::string &tab, const Buyout &buyout);
     Buyout GetTab(const std::string &tab) const;
@@ -170,19 +171,22 @@ public:
     void Save();
     void Load();
 
-    void MigrateItem(const Item &item);
+    // Moves the buyout stored under a key of an older version to the item's hash
+    void MigrateItem(const Item &item, const std::string &legacy_hash);
 private:
     Currency StringToCurrencyType(std::string currency) const;
     BuyoutType StringToBuyoutType(std::string bo_str) const;
 
-    std::string Serialize(const std::map<std::string, Buyout> &buyouts);
-    void Deserialize(const std::string &data, std::map<std::string, Buyout> *buyouts);
+    template <typename Key>
+    std::string Serialize(const std::map<Key, Buyout> &buyouts);
+    template <typename Key>
+    void Deserialize(const std::string &data, std::map<Key, Buyout> *buyouts);
 
     std::string Serialize(const std::map<std::string, bool> &obj);
     void Deserialize(const std::string &data, std::map<std::string, bool> &obj);
 
     DataStore &data_;
-    std::map<std::string, Buyout> buyouts_;
+    std::map<ItemHash, Buyout> buyouts_;
     std::map<std::string, Buyout> tab_buyouts_;
     std::map<std::string, bool> refresh_checked_;
     std::set<std::string> refresh_locked_;
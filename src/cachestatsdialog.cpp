@@ -0,0 +1,98 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "cachestatsdialog.h"
+
+#include <QDateTime>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+#include "tabcache.h"
+
+namespace {
+
+QString Megabytes(qint64 bytes) {
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + " MB";
+}
+
+QString Ratio(qint64 hits, qint64 misses) {
+    if (hits + misses == 0)
+        return "-";
+    return QString::number(100.0 * hits / (hits + misses), 'f', 0) + "%";
+}
+
+}
+
+CacheStatsDialog::CacheStatsDialog(TabCache &cache, QWidget *parent) :
+    QDialog(parent),
+    cache_(cache),
+    text_(new QPlainTextEdit)
+{
+    setWindowTitle("Tab cache");
+    resize(640, 480);
+    text_->setReadOnly(true);
+    text_->setLineWrapMode(QPlainTextEdit::NoWrap);
+
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Save | QDialogButtonBox::Close);
+    QPushButton *refresh = buttons->addButton("Refresh", QDialogButtonBox::ActionRole);
+    connect(refresh, SIGNAL(clicked()), this, SLOT(Refresh()));
+    connect(buttons, SIGNAL(accepted()), this, SLOT(Save()));
+    connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+
+    auto layout = new QVBoxLayout(this);
+    layout->addWidget(text_);
+    layout->addWidget(buttons);
+
+    Refresh();
+}
+
+void CacheStatsDialog::Refresh() {
+    TabCacheStats stats = cache_.Stats();
+    std::vector<TabCacheEntry> entries = cache_.Snapshot();
+
+    QStringList lines;
+    lines << "Directory: " + cache_.cacheDirectory();
+    lines << QString("Entries: %1, %2 of %3 (%4 stored for all leagues)").arg(stats.entries)
+        .arg(Megabytes(stats.size)).arg(Megabytes(stats.maximum_size)).arg(Megabytes(stats.objects_size));
+    lines << QString("Served from cache: %1 of %2 replies (%3), %4 not downloaded").arg(stats.hits)
+        .arg(stats.hits + stats.misses).arg(Ratio(stats.hits, stats.misses)).arg(Megabytes(stats.bytes_served));
+    lines << QString("Last refresh: %1 of %2 replies from cache (%3)").arg(stats.refresh_hits)
+        .arg(stats.refresh_hits + stats.refresh_misses).arg(Ratio(stats.refresh_hits, stats.refresh_misses));
+    lines << QString("Memory: %1 of %2, %3 hits, %4 misses, %5 evictions").arg(Megabytes(stats.memory_size))
+        .arg(Megabytes(stats.memory_limit)).arg(stats.memory_hits).arg(stats.memory_misses).arg(stats.memory_evictions);
+    lines << "";
+    lines << "Last used            Size      URL";
+    for (auto &entry : entries) {
+        lines << QString("%1  %2  %3")
+            .arg(QDateTime::fromMSecsSinceEpoch(entry.last_used).toString("yyyy-MM-dd hh:mm:ss"))
+            .arg(QString::number(entry.size), -8)
+            .arg(entry.url.toDisplayString());
+    }
+    text_->setPlainText(lines.join("\n"));
+}
+
+void CacheStatsDialog::Save() {
+    QString path = QFileDialog::getSaveFileName(this, "Save cache statistics", "tabcache.stats.json", "JSON (*.json)");
+    if (!path.isEmpty())
+        cache_.Dump(path);
+}
@@ -117,11 +117,34 @@ std::string PropertyColumn::name() const {
 }
 
 QVariant PropertyColumn::value(const Item &item) const {
-    if (item.properties().count(property_))
-        return item.properties().find(property_)->second.c_str();
+    const ItemNumericProperty *property = item.property(property_);
+    if (property)
+        return property->text.c_str();
     return QVariant();
 }
 
+bool PropertyColumn::lt(const Item *lhs, const Item *rhs) const {
+    const ItemNumericProperty *l = lhs->property(property_), *r = rhs->property(property_);
+    bool l_numeric = l && l->numeric, r_numeric = r && r->numeric;
+    if (l_numeric != r_numeric)
+        return r_numeric;
+    if (l_numeric) {
+        // Stack sizes like "10/20" go by name first, then by the size, as Column::multivalue sorts them
+        bool l_stack = l->text.find('/') != std::string::npos;
+        bool r_stack = r->text.find('/') != std::string::npos;
+        if (l_stack && r_stack && lhs->PrettyName() != rhs->PrettyName())
+            return lhs->PrettyName() < rhs->PrettyName();
+        if (l->average() != r->average())
+            return l->average() < r->average();
+    } else {
+        const std::string &l_text = l ? l->text : std::string();
+        const std::string &r_text = r ? r->text : std::string();
+        if (l_text != r_text)
+            return l_text < r_text;
+    }
+    return *lhs < *rhs;
+}
+
 std::string DPSColumn::name() const {
     return "DPS";
 }
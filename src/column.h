@@ -58,9 +58,13 @@ public:
     PropertyColumn(const std::string &name, const std::string &property);
     std::string name() const;
     QVariant value(const Item &item) const;
+    // Same order as Column::lt except that values which aren't numbers, or are missing, come
+    // before all numbers instead of depending on how QVariant compares a string to a number.
+    // Ranges sort by their average, stack sizes like "10/20" by item name and then size.
+    bool lt(const Item *lhs, const Item *rhs) const;
 private:
     std::string name_;
-    std::string property_;
+    InternedString property_;
 };
 
 class DPSColumn : public Column {
@@ -243,12 +243,15 @@ void CurrencyManager::ExportCurrency() {
 }
 
 void CurrencyManager::ParseSingleItem(const Item &item) {
+    // Currency has no name, only a type line
+    if (!item.name().empty())
+        return;
     for (unsigned int i = 0; i < currencies_.size(); i++)
-        if (item.PrettyName() == currencies_[i]->name)
+        if (item.type_line() == currencies_[i]->name)
             currencies_[i]->count += item.count();
 
     for (unsigned int i = 0; i < wisdoms_.size(); i++)
-        if (item.PrettyName() == CurrencyForWisdom[i])
+        if (item.type_line() == CurrencyForWisdom[i])
             wisdoms_[i] += item.count();
 }
 
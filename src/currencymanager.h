@@ -24,6 +24,7 @@
 
 #include "application.h"
 #include "buyoutmanager.h"
+#include "internedstring.h"
 struct CurrencyRatio {
     Currency curr1;
     Currency curr2;
@@ -46,7 +47,7 @@ struct CurrencyRatio {
 struct CurrencyItem {
     int count;
     Currency currency;
-    std::string name;
+    InternedString name;
     CurrencyRatio exalt;
     CurrencyRatio chaos;
     CurrencyItem(int co, Currency curr, double chaos_ratio, double exalt_ratio) {
@@ -111,7 +112,7 @@ struct CurrencyUpdate {
     std::string value;
 };
 
-const std::vector<std::string> CurrencyForWisdom({
+const std::vector<InternedString> CurrencyForWisdom({
     "Scroll of Wisdom",
     "Portal Scroll",
     "Armourer's Scrap",
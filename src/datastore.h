@@ -24,6 +24,16 @@
 
 #include "currencymanager.h"
 
+// Items of one tab or character as ItemsManagerWorker stores them
+struct StoredLocation {
+    // ItemLocation::GetHeader
+    std::string key;
+    // JSON array of the items
+    std::string items;
+    // of the reply the items were parsed from, see TabParser
+    std::string fingerprint;
+};
+
 class DataStore {
 public:
     virtual ~DataStore() {};
@@ -35,4 +45,7 @@ public:
     virtual bool GetBool(const std::string &key, bool default_value = false) = 0;
     virtual void SetInt(const std::string &key, int value) = 0;
     virtual int GetInt(const std::string &key, int default_value = 0) = 0;
+    virtual std::vector<StoredLocation> GetLocations() = 0;
+    // Adds or replaces locations and deletes the removed ones, either all of it happens or nothing
+    virtual bool SetLocations(const std::vector<StoredLocation> &locations, const std::vector<std::string> &removed) = 0;
 };
@@ -17,6 +17,8 @@
     along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <QCheckBox>
 #include <QGroupBox>
@@ -51,6 +53,16 @@ bool FilterData::Matches(const std::shared_ptr<Item> item) {
     return filter_->Matches(item, this);
 }
 
+void FilterData::Select(const ItemStore &store, std::vector<uint8_t> *mask) {
+    filter_->Select(store, this, mask);
+}
+
+void Filter::Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask) {
+    for (size_t row = 0; row < store.size(); ++row)
+        if ((*mask)[row] && !Matches(store.item(row), data))
+            (*mask)[row] = 0;
+}
+
 void FilterData::FromForm() {
     filter_->FromForm(this);
 }
@@ -124,6 +136,20 @@ bool CategorySearchFilter::Matches(const std::shared_ptr<Item> &item, FilterData
     return item->category().find(data->text_query) != std::string::npos;
 }
 
+void CategorySearchFilter::Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask) {
+    if (data->text_query.empty())
+        return;
+    // There are only a few dozen categories, look at each one once
+    std::vector<uint8_t> matches;
+    matches.reserve(store.categories().size());
+    for (auto &category : store.categories())
+        matches.push_back(category.str().find(data->text_query) != std::string::npos);
+    const uint32_t *ids = store.category_ids().data();
+    uint8_t *m = mask->data();
+    for (size_t row = 0, rows = store.size(); row < rows; ++row)
+        m[row] &= matches[ids[row]];
+}
+
 void CategorySearchFilter::Initialize(QLayout *parent) {
     QWidget *group = new QWidget;
     QHBoxLayout *layout = new QHBoxLayout;
@@ -222,36 +248,66 @@ bool MinMaxFilter::Matches(const std::shared_ptr<Item> &item, FilterData *data)
     }
 }
 
+void MinMaxFilter::Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask) {
+    const std::vector<double> *values = Values(store);
+    if (!values) {
+        Filter::Select(store, data, mask);
+        return;
+    }
+    if (!data->min_filled && !data->max_filled)
+        return;
+    // Same as Matches: comparisons with NaN are false, so rows without a value are dropped
+    double min = data->min_filled ? data->min : -std::numeric_limits<double>::infinity();
+    double max = data->max_filled ? data->max : std::numeric_limits<double>::infinity();
+    double absent = AbsentValue();
+    const double *v = values->data();
+    uint8_t *m = mask->data();
+    for (size_t row = 0, rows = values->size(); row < rows; ++row) {
+        double value = std::isnan(v[row]) ? absent : v[row];
+        m[row] &= (value >= min) & (value <= max);
+    }
+}
+
+double MinMaxFilter::AbsentValue() const {
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
 bool SimplePropertyFilter::IsValuePresent(const std::shared_ptr<Item> &item) {
-    return item->properties().count(property_);
+    const ItemNumericProperty *property = item->property(key_);
+    return property && property->numeric;
 }
 
 double SimplePropertyFilter::GetValue(const std::shared_ptr<Item> &item) {
-    return std::stod(item->properties().at(property_));
+    return item->property(key_)->min;
 }
 
 double DefaultPropertyFilter::GetValue(const std::shared_ptr<Item> &item) {
-    if (!item->properties().count(property_))
+    if (!SimplePropertyFilter::IsValuePresent(item))
         return default_value_;
     return SimplePropertyFilter::GetValue(item);
 }
 
 double RequiredStatFilter::GetValue(const std::shared_ptr<Item> &item) {
-    auto &requirements = item->requirements();
-    if (requirements.count(property_))
-        return requirements.at(property_);
-    return 0;
+    return item->requirement(key_);
 }
 
-ItemMethodFilter::ItemMethodFilter(QLayout *parent, std::function<double (Item *)> func, std::string caption):
+ItemMethodFilter::ItemMethodFilter(QLayout *parent, std::function<double (Item *)> func, std::string caption,
+                                   ItemStore::Attribute attribute):
     MinMaxFilter(parent, caption, caption),
-    func_(func)
+    func_(func),
+    attribute_(attribute)
 {}
 
 double ItemMethodFilter::GetValue(const std::shared_ptr<Item> &item) {
     return func_(&*item);
 }
 
+const std::vector<double> *ItemMethodFilter::Values(const ItemStore &store) {
+    if (attribute_ == ItemStore::ATTRIBUTE_COUNT)
+        return nullptr;
+    return &store.attribute(attribute_);
+}
+
 double SocketsFilter::GetValue(const std::shared_ptr<Item> &item) {
     return item->sockets_cnt();
 }
@@ -340,6 +396,19 @@ bool SocketsColorsFilter::Matches(const std::shared_ptr<Item> &item, FilterData
     return Check(need_r, need_g, need_b, sockets.r, sockets.g, sockets.b, sockets.w);
 }
 
+void SocketsColorsFilter::Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask) {
+    if (!data->r_filled && !data->g_filled && !data->b_filled)
+        return;
+    int need_r = data->r_filled ? data->r : 0;
+    int need_g = data->g_filled ? data->g : 0;
+    int need_b = data->b_filled ? data->b : 0;
+    const uint8_t *r = store.sockets_r().data(), *g = store.sockets_g().data();
+    const uint8_t *b = store.sockets_b().data(), *w = store.sockets_w().data();
+    uint8_t *m = mask->data();
+    for (size_t row = 0, rows = store.size(); row < rows; ++row)
+        m[row] &= Check(need_r, need_g, need_b, r[row], g[row], b[row], w[row]);
+}
+
 LinksColorsFilter::LinksColorsFilter(QLayout *parent) {
     Initialize(parent, "Linked");
 }
@@ -405,6 +474,15 @@ bool MTXFilter::Matches(const std::shared_ptr<Item> &item, FilterData *data) {
     return !data->checked || item->has_mtx();
 }
 
+void MTXFilter::Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask) {
+    if (!data->checked)
+        return;
+    const uint8_t *mtx = store.has_mtx().data();
+    uint8_t *m = mask->data();
+    for (size_t row = 0, rows = store.size(); row < rows; ++row)
+        m[row] &= mtx[row];
+}
+
 bool AltartFilter::Matches(const std::shared_ptr<Item> &item, FilterData *data) {
     static std::vector<std::string> altart = {
         // season 1
@@ -462,6 +540,15 @@ bool PricedFilter::Matches(const std::shared_ptr<Item> &item, FilterData *data)
     return bm_.Get(*item).IsActive();
 }
 
+void PricedFilter::Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask) {
+    if (!data->checked)
+        return;
+    auto &hashes = store.hashes();
+    for (size_t row = 0; row < store.size(); ++row)
+        if ((*mask)[row] && !bm_.Get(hashes[row]).IsActive())
+            (*mask)[row] = 0;
+}
+
 double ItemlevelFilter::GetValue(const std::shared_ptr<Item> &item) {
     return item->ilvl();
 }
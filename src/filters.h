@@ -23,6 +23,7 @@
 #include <memory>
 
 #include "item.h"
+#include "itemstore.h"
 #include "mainwindow.h"
 #include "porting.h"
 #include "ui_mainwindow.h"
@@ -39,6 +40,7 @@ class QAbstractListModel;
  * 1) FromForm: provided with a FilterData fill it with data from form
  * 2) ToForm: provided with a FilterData fill form with data from it
  * 3) Matches: check if an item matches the filter provided with FilterData
+ * 4) Select: same for every row of an ItemStore at once
  */
 class Filter {
 public:
@@ -46,6 +48,9 @@ public:
     virtual void ToForm(FilterData *data) = 0;
     virtual void ResetForm() = 0;
     virtual bool Matches(const std::shared_ptr<Item> &item, FilterData *data) = 0;
+    // Clears mask[row] for rows of store that don't match.  The default calls Matches for
+    // every row still set, filters on an ItemStore column scan the column instead.
+    virtual void Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask);
     virtual ~Filter() {};
     std::unique_ptr<FilterData> CreateData();
 };
@@ -73,6 +78,7 @@ public:
     FilterData(Filter *filter);
     Filter *filter () { return filter_; }
     bool Matches(const std::shared_ptr<Item> item);
+    void Select(const ItemStore &store, std::vector<uint8_t> *mask);
     void FromForm();
     void ToForm();
     // Various types of data for various filters
@@ -107,6 +113,7 @@ public:
     void ToForm(FilterData *data);
     void ResetForm();
     bool Matches(const std::shared_ptr<Item> &item, FilterData *data);
+    void Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask);
     void Initialize(QLayout *parent);
     static const std::string k_Default;
 private:
@@ -123,10 +130,16 @@ public:
     void ToForm(FilterData *data);
     void ResetForm();
     bool Matches(const std::shared_ptr<Item> &item, FilterData *data);
+    void Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask);
     void Initialize(QLayout *parent);
 protected:
     virtual double GetValue(const std::shared_ptr<Item> &item) = 0;
     virtual bool IsValuePresent(const std::shared_ptr<Item> &item) = 0;
+    // Column of the store GetValue reads, NaN where IsValuePresent is false.  nullptr if
+    // there's none, Select falls back to Matches then.
+    virtual const std::vector<double> *Values(const ItemStore & /* store */) { return nullptr; }
+    // What Select uses for NaN
+    virtual double AbsentValue() const;
 
     std::string property_, caption_;
 private:
@@ -136,12 +149,15 @@ private:
 class SimplePropertyFilter : public MinMaxFilter {
 public:
     SimplePropertyFilter(QLayout *parent, std::string property) :
-        MinMaxFilter(parent, property) {}
+        MinMaxFilter(parent, property), key_(property) {}
     SimplePropertyFilter(QLayout *parent, std::string property, std::string caption) :
-        MinMaxFilter(parent, property, caption) {}
+        MinMaxFilter(parent, property, caption), key_(property) {}
 protected:
     bool IsValuePresent(const std::shared_ptr<Item> &item);
     double GetValue(const std::shared_ptr<Item> &item);
+    const std::vector<double> *Values(const ItemStore &store) { return &store.property(key_); }
+    // property_ interned, looking it up in an item only compares pointers
+    InternedString key_;
 };
 
 // Just like SimplePropertyFilter but assumes given default value instead of excluding items
@@ -158,6 +174,7 @@ public:
 protected:
     bool IsValuePresent(const std::shared_ptr<Item> & /* item */) { return true; }
     double GetValue(const std::shared_ptr<Item> &item);
+    double AbsentValue() const { return default_value_; }
 private:
     double default_value_;
 };
@@ -165,21 +182,27 @@ private:
 class RequiredStatFilter : public MinMaxFilter {
 public:
     RequiredStatFilter(QLayout *parent, std::string property) :
-        MinMaxFilter(parent, property) {}
+        MinMaxFilter(parent, property), key_(property) {}
     RequiredStatFilter(QLayout *parent, std::string property, std::string caption) :
-        MinMaxFilter(parent, property, caption) {}
+        MinMaxFilter(parent, property, caption), key_(property) {}
 private:
     bool IsValuePresent(const std::shared_ptr<Item> & /* item */) { return true; }
     double GetValue(const std::shared_ptr<Item> &item);
+    const std::vector<double> *Values(const ItemStore &store) { return &store.requirement(key_); }
+    InternedString key_;
 };
 
 class ItemMethodFilter : public MinMaxFilter {
 public:
-    ItemMethodFilter(QLayout *parent, std::function<double(Item*)> func, std::string caption);
+    // attribute is the column of ItemStore holding what func returns, if there is one
+    ItemMethodFilter(QLayout *parent, std::function<double(Item*)> func, std::string caption,
+                     ItemStore::Attribute attribute = ItemStore::ATTRIBUTE_COUNT);
 private:
     bool IsValuePresent(const std::shared_ptr<Item> & /* item */) { return true; }
     double GetValue(const std::shared_ptr<Item> &item);
+    const std::vector<double> *Values(const ItemStore &store);
     std::function<double(Item*)> func_;
+    ItemStore::Attribute attribute_;
 };
 
 class SocketsFilter : public MinMaxFilter {
@@ -190,6 +213,7 @@ public:
         MinMaxFilter(parent, property, caption) {}
     bool IsValuePresent(const std::shared_ptr<Item> & /* item */) { return true; }
     double GetValue(const std::shared_ptr<Item> &item);
+    const std::vector<double> *Values(const ItemStore &store) { return &store.attribute(ItemStore::SOCKETS); }
 };
 
 class LinksFilter : public MinMaxFilter {
@@ -200,6 +224,7 @@ public:
         MinMaxFilter(parent, property, caption) {}
     bool IsValuePresent(const std::shared_ptr<Item> & /* item */) { return true; }
     double GetValue(const std::shared_ptr<Item> &item);
+    const std::vector<double> *Values(const ItemStore &store) { return &store.attribute(ItemStore::LINKS); }
 };
 
 class SocketsColorsFilter : public Filter {
@@ -210,6 +235,7 @@ public:
     void ToForm(FilterData *data);
     void ResetForm();
     bool Matches(const std::shared_ptr<Item> &item, FilterData *data);
+    void Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask);
     void Initialize(QLayout *parent, const char* caption);
 protected:
     bool Check(int need_r, int need_g, int need_b, int got_r, int got_g, int got_b, int got_w);
@@ -220,6 +246,10 @@ class LinksColorsFilter : public SocketsColorsFilter {
 public:
     explicit LinksColorsFilter(QLayout *parent);
     bool Matches(const std::shared_ptr<Item> &item, FilterData *data);
+    // Socket groups aren't in the store
+    void Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask) {
+        Filter::Select(store, data, mask);
+    }
 };
 
 class BooleanFilter : public Filter {
@@ -241,6 +271,7 @@ public:
     MTXFilter(QLayout *parent, std::string property, std::string caption):
         BooleanFilter(parent, property, caption) {}
     bool Matches(const std::shared_ptr<Item> &item, FilterData *data);
+    void Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask);
 };
 
 class AltartFilter : public BooleanFilter {
@@ -258,6 +289,7 @@ public:
         bm_(bm)
     {}
     bool Matches(const std::shared_ptr<Item> &item, FilterData *data);
+    void Select(const ItemStore &store, FilterData *data, std::vector<uint8_t> *mask);
 private:
     const BuyoutManager &bm_;
 };
@@ -270,4 +302,5 @@ public:
         MinMaxFilter(parent, property, caption) {}
     bool IsValuePresent(const std::shared_ptr<Item> & /* item */) { return true; }
     double GetValue(const std::shared_ptr<Item> &item);
+    const std::vector<double> *Values(const ItemStore &store) { return &store.attribute(ItemStore::ILVL); }
 };
@@ -0,0 +1,86 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "internedstring.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <unordered_set>
+
+namespace {
+
+// Items are parsed on a thread pool, spread the pool over a few locks so they rarely meet
+const size_t kShards = 16;
+
+struct Shard {
+    QMutex mutex;
+    // Elements of an unordered_set keep their address when it grows
+    std::unordered_set<std::string> strings;
+    size_t bytes{0};
+};
+
+Shard *Shards() {
+    static Shard shards[kShards];
+    return shards;
+}
+
+const std::string *Intern(const std::string &str) {
+    static const std::string empty;
+    if (str.empty())
+        return &empty;
+    Shard &shard = Shards()[std::hash<std::string>()(str) % kShards];
+    QMutexLocker locker(&shard.mutex);
+    auto inserted = shard.strings.insert(str);
+    if (inserted.second)
+        shard.bytes += str.size();
+    return &*inserted.first;
+}
+
+}
+
+InternedString::InternedString() :
+    str_(Intern(std::string()))
+{}
+
+InternedString::InternedString(const std::string &str) :
+    str_(Intern(str))
+{}
+
+InternedString::InternedString(const char *str) :
+    str_(Intern(str))
+{}
+
+size_t InternedString::pooled_strings() {
+    size_t count = 0;
+    for (size_t i = 0; i < kShards; ++i) {
+        QMutexLocker locker(&Shards()[i].mutex);
+        count += Shards()[i].strings.size();
+    }
+    return count;
+}
+
+size_t InternedString::pooled_bytes() {
+    size_t bytes = 0;
+    for (size_t i = 0; i < kShards; ++i) {
+        QMutexLocker locker(&Shards()[i].mutex);
+        bytes += Shards()[i].bytes;
+    }
+    return bytes;
+}
@@ -0,0 +1,72 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/*
+ * Handle to a string kept in a process-wide pool.  Equal strings share one
+ * copy, so handles are a pointer in size and comparing them for equality is a
+ * pointer compare.  Pooled strings are never freed, so only text with few
+ * distinct values belongs here: type lines, categories, icons, property and
+ * requirement names, tab and character names.  Mod lines, property values and
+ * item names are close to unique and stay plain strings, the pool would grow
+ * with every item ever seen.
+ * Handles can be created from any thread.
+ */
+class InternedString {
+public:
+    InternedString();
+    InternedString(const std::string &str);
+    InternedString(const char *str);
+    const std::string &str() const { return *str_; }
+    operator const std::string &() const { return *str_; }
+    const char *c_str() const { return str_->c_str(); }
+    bool empty() const { return str_->empty(); }
+    size_t size() const { return str_->size(); }
+    // Number of distinct strings and their bytes in the pool, for diagnostics
+    static size_t pooled_strings();
+    static size_t pooled_bytes();
+private:
+    const std::string *str_;
+};
+
+// Free functions so that either side can be a plain string
+inline bool operator==(const InternedString &lhs, const InternedString &rhs) { return &lhs.str() == &rhs.str(); }
+inline bool operator!=(const InternedString &lhs, const InternedString &rhs) { return &lhs.str() != &rhs.str(); }
+// Orders by contents so containers sort the same as they would with plain strings
+inline bool operator<(const InternedString &lhs, const InternedString &rhs) {
+    return &lhs.str() != &rhs.str() && lhs.str() < rhs.str();
+}
+
+// std::string's operator+ are templates and don't see the conversion above
+inline std::string operator+(const std::string &lhs, const InternedString &rhs) { return lhs + rhs.str(); }
+inline std::string operator+(const InternedString &lhs, const std::string &rhs) { return lhs.str() + rhs; }
+inline std::string operator+(const char *lhs, const InternedString &rhs) { return lhs + rhs.str(); }
+inline std::string operator+(const InternedString &lhs, const char *rhs) { return lhs.str() + rhs; }
+
+namespace std {
+    template <> struct hash<InternedString> {
+        size_t operator()(const InternedString &str) const { return hash<const std::string *>()(&str.str()); }
+    };
+}
@@ -19,6 +19,8 @@
 
 #include "item.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <utility>
 #include <QString>
 #include <boost/algorithm/string.hpp>
@@ -53,17 +55,68 @@ const std::vector<std::string> ITEM_MOD_TYPES = {
     "implicitMods", "enchantMods", "explicitMods", "craftedMods", "cosmeticMods"
 };
 
-static std::string item_unique_properties(const rapidjson::Value &json, const std::string &name) {
-    const char *name_p = name.c_str();
-    if (!json.HasMember(name_p))
-        return "";
-    std::string result;
-    for (auto &prop : json[name_p]) {
-        result += std::string(prop["name"].GetString()) + "~";
-        for (auto &value : prop["values"])
-            result += std::string(value[0].GetString()) + "~";
+// What identifies an item besides its name and location: mods, properties and
+// sockets, every value followed by '~'.  Both hashes are over these same bytes.
+template <typename Add>
+static void add_unique_fields(const rapidjson::Value &json, Add add) {
+    auto value = [&add](const rapidjson::Value &str) {
+        add(str.GetString(), str.GetStringLength());
+        add("~", 1);
+    };
+
+    if (json.HasMember("explicitMods") && json["explicitMods"].IsArray())
+        for (auto &mod : json["explicitMods"])
+            if (mod.IsString())
+                value(mod);
+
+    if (json.HasMember("implicitMods") && json["implicitMods"].IsArray())
+        for (auto &mod : json["implicitMods"])
+            if (mod.IsString())
+                value(mod);
+
+    for (const char *name : { "properties", "additionalProperties" }) {
+        if (json.HasMember(name)) {
+            for (auto &prop : json[name]) {
+                value(prop["name"]);
+                for (auto &v : prop["values"])
+                    value(v[0]);
+            }
+        }
+        add("~", 1);
     }
-    return result;
+
+    if (json.HasMember("sockets") && json["sockets"].IsArray())
+        for (auto &socket : json["sockets"]) {
+            if (!socket.HasMember("group") || !socket.HasMember("attr") || !socket["group"].IsInt() || !socket["attr"].IsString())
+                continue;
+            std::string group = std::to_string(socket["group"].GetInt());
+            add(group.c_str(), group.size());
+            add("~", 1);
+            value(socket["attr"]);
+        }
+}
+
+static bool has_raw_names(const rapidjson::Value &json) {
+    return json.HasMember("name") && json.HasMember("typeLine") && json["name"].IsString() && json["typeLine"].IsString();
+}
+
+// Leading number of a property value the same way std::stod reads it, plus the
+// upper end if it's a range
+static bool parse_property_number(const std::string &text, double *min, double *max) {
+    const char *begin = text.c_str();
+    char *end;
+    double first = std::strtod(begin, &end);
+    if (end == begin)
+        return false;
+    *min = *max = first;
+    if (*end == '-') {
+        const char *second_begin = end + 1;
+        char *second_end;
+        double second = std::strtod(second_begin, &second_end);
+        if (second_end != second_begin)
+            *max = second;
+    }
+    return true;
 }
 
 // Fix up names, remove all <<set:X>> modifiers
@@ -78,22 +131,41 @@ static std::string fixup_name(const std::string &name) {
 Item::Item(const std::string &name, const ItemLocation &location) :
     name_(name),
     location_(location),
-    hash_(Util::Md5(name)) // Unique enough for tests
+    pretty_name_(name + " ")
+{
+    // Unique enough for tests
+    ItemHasher hasher;
+    hasher.Add(name);
+    hash_ = hasher.Finish();
+}
+
+Item::Item(const rapidjson::Value &json, std::shared_ptr<ItemArena> arena) :
+    Item(json, ItemJson(Util::RapidjsonSerialize(json)), std::move(arena))
 {}
 
-Item::Item(const rapidjson::Value &json) :
+Item::Item(const rapidjson::Value &json, ItemJson serialized, std::shared_ptr<ItemArena> arena) :
+    arena_(std::move(arena)),
+    category_vector_(arena_.get()),
     corrupted_(false),
     identified_(true),
     w_(0),
     h_(0),
     frameType_(0),
     location_(ItemLocation(json)),
+    properties_(arena_.get()),
+    elemental_damage_(arena_.get()),
     sockets_cnt_(0),
     links_cnt_(0),
     sockets_({ 0, 0, 0, 0 }),
-    json_(Util::RapidjsonSerialize(json)),
+    socket_groups_(arena_.get()),
+    json_(std::move(serialized)),
     has_mtx_(false),
-    ilvl_(0)
+    ilvl_(0),
+    text_properties_(arena_.get()),
+    text_requirements_(arena_.get()),
+    text_mods_(arena_.get()),
+    text_sockets_(arena_.get()),
+    mod_table_(arena_.get())
 {
     if (json.HasMember("name") && json["name"].IsString())
         name_ = fixup_name(json["name"].GetString());
@@ -113,14 +185,19 @@ Item::Item(const rapidjson::Value &json) :
     if (json.HasMember("frameType") && json["frameType"].IsInt())
         frameType_ = json["frameType"].GetInt();
 
+    pretty_name_ = name_.empty() ? typeLine_.str() : name_ + " " + typeLine_;
+
+    std::string icon;
     if (json.HasMember("icon") && json["icon"].IsString())
-        icon_ = json["icon"].GetString();
+        icon = json["icon"].GetString();
 
-    for (auto &mod_type : ITEM_MOD_TYPES) {
-        text_mods_[mod_type] = std::vector<std::string>();
-        const char *mod_type_s = mod_type.c_str();
+    text_mods_.reserve(ITEM_MOD_TYPES.size());
+    for (size_t i = 0; i < ITEM_MOD_TYPES.size(); ++i) {
+        text_mods_.emplace_back(arena_.get());
+        const char *mod_type_s = ITEM_MOD_TYPES[i].c_str();
         if (json.HasMember(mod_type_s) && json[mod_type_s].IsArray()) {
-            auto &mods = text_mods_[mod_type];
+            auto &mods = text_mods_[i];
+            mods.reserve(json[mod_type_s].Size());
             for (auto &mod : json[mod_type_s])
                 if (mod.IsString())
                     mods.push_back(mod.GetString());
@@ -129,23 +206,27 @@ Item::Item(const rapidjson::Value &json) :
 
     // Other code assumes icon is proper size so force quad=1 to quad=0 here as it's clunky
     // to handle elsewhere
-    boost::replace_last(icon_, "quad=1", "quad=0");
+    boost::replace_last(icon, "quad=1", "quad=0");
+    icon_ = icon;
 
     // Derive item type 'category' hierarchy from icon path.
     std::smatch sm;
-    if (std::regex_search(icon_, sm, std::regex("Art/.*?/(.*)/"))) {
+    if (std::regex_search(icon, sm, std::regex("Art/.*?/(.*)/"))) {
         std::string match = sm.str(1);
-        boost::split(category_vector_,match,boost::is_any_of("/"));
+        std::vector<std::string> category_vector;
+        boost::split(category_vector,match,boost::is_any_of("/"));
         //Compress terms with redundant identifiers
         //Weapons.OneHandWeapons.OneHandMaces -> Weapons.OneHand.Maces
-        size_t min = std::min(category_vector_.size(), replace_map_.size());
+        size_t min = std::min(category_vector.size(), replace_map_.size());
         for (size_t i = 1; i < min; i++) {
-            auto it = replace_map_[i].find(category_vector_[i]);
+            auto it = replace_map_[i].find(category_vector[i]);
             if (it != replace_map_[i].end())
-                category_vector_[i] = it->second;
+                category_vector[i] = it->second;
         }
-        category_ = boost::join(category_vector_, ".");
-        boost::to_lower(category_);
+        category_vector_.assign(category_vector.begin(), category_vector.end());
+        std::string category = boost::join(category_vector, ".");
+        boost::to_lower(category);
+        category_ = category;
     }
 
     if (json.HasMember("talismanTier") && json["talismanTier"].IsUint()) {
@@ -161,6 +242,8 @@ Item::Item(const rapidjson::Value &json) :
     }
 
     if (json.HasMember("properties") && json["properties"].IsArray()) {
+        properties_.reserve(json["properties"].Size());
+        text_properties_.reserve(json["properties"].Size());
         for (auto prop_it = json["properties"].Begin(); prop_it != json["properties"].End(); ++prop_it) {
             auto &prop = *prop_it;
             if (!prop.HasMember("name") || !prop["name"].IsString() || !prop.HasMember("values") || !prop["values"].IsArray())
@@ -169,20 +252,32 @@ Item::Item(const rapidjson::Value &json) :
             if (name == "Map Level")
                 name = "Level";
             if (name == "Elemental Damage") {
+                elemental_damage_.reserve(prop["values"].Size());
                 for (auto value_it = prop["values"].Begin(); value_it != prop["values"].End(); ++value_it) {
                     auto &value = *value_it;
                     if (value.IsArray() && value.Size() >= 2 && value[0].IsString() && value[1].IsInt())
-                        elemental_damage_.push_back(std::make_pair(value[0].GetString(), value[1].GetInt()));
+                        elemental_damage_.push_back(std::make_pair(std::string(value[0].GetString()), value[1].GetInt()));
                 }
             } else {
                 if (prop["values"].Size() > 0 && prop["values"][0].IsArray() && prop["values"][0].Size() > 0 &&
-                        prop["values"][0][0].IsString())
-                    properties_[name] = prop["values"][0][0].GetString();
+                        prop["values"][0][0].IsString()) {
+                    ItemNumericProperty parsed;
+                    parsed.name = name;
+                    parsed.text = prop["values"][0][0].GetString();
+                    parsed.min = parsed.max = 0;
+                    parsed.numeric = parse_property_number(parsed.text, &parsed.min, &parsed.max);
+                    // a repeated name replaces the earlier value
+                    auto it = std::find_if(properties_.begin(), properties_.end(),
+                        [&](const ItemNumericProperty &p) { return p.name == parsed.name; });
+                    if (it != properties_.end())
+                        *it = parsed;
+                    else
+                        properties_.push_back(parsed);
+                }
             }
 
-            ItemProperty property;
-            property.name = name;
-            property.display_mode = prop["displayMode"].GetInt();
+            ItemProperty property{ name, ArenaVector<ItemPropertyValue>(arena_.get()), prop["displayMode"].GetInt() };
+            property.values.reserve(prop["values"].Size());
             for (auto &value : prop["values"]) {
                 if (value.IsArray() && value.Size() >= 2 && value[0].IsString() && value[1].IsInt()) {
                     ItemPropertyValue v;
@@ -191,23 +286,22 @@ Item::Item(const rapidjson::Value &json) :
                     property.values.push_back(v);
                 }
             }
-            text_properties_.push_back(property);
+            text_properties_.push_back(std::move(property));
         }
     }
 
     if (json.HasMember("requirements") && json["requirements"].IsArray()) {
+        text_requirements_.reserve(json["requirements"].Size());
         for (auto &req : json["requirements"]) {
             if (req.IsObject() && req.HasMember("name") && req["name"].IsString() &&
                     req.HasMember("values") && req["values"].IsArray() && req["values"].Size() >= 1 &&
                     req["values"][0].IsArray() && req["values"][0].Size() >= 2 &&
                     req["values"][0][0].IsString() && req["values"][0][1].IsInt()) {
-                std::string name = req["name"].GetString();
-                std::string value = req["values"][0][0].GetString();
-                requirements_[name] = std::atoi(value.c_str());
+                const char *value = req["values"][0][0].GetString();
                 ItemPropertyValue v;
                 v.str = value;
                 v.type = req["values"][0][1].GetInt();
-                text_requirements_.push_back({ name, v });
+                text_requirements_.push_back({ req["name"].GetString(), v, std::atoi(value) });
             }
         }
     }
@@ -215,6 +309,9 @@ Item::Item(const rapidjson::Value &json) :
     if (json.HasMember("sockets") && json["sockets"].IsArray()) {
         ItemSocketGroup current_group = { 0, 0, 0, 0 };
         sockets_cnt_ = json["sockets"].Size();
+        text_sockets_.reserve(sockets_cnt_);
+        // a group for every socket at most, plus the empty one pushed first
+        socket_groups_.reserve(sockets_cnt_ + 1);
         int counter = 0, prev_group = -1;
         for (auto &socket : json["sockets"]) {
             if (!socket.IsObject() || !socket.HasMember("group") || !socket["group"].IsInt())
@@ -264,13 +361,11 @@ Item::Item(const rapidjson::Value &json) :
     CalculateHash(json);
 
     count_ = 1;
-    if (properties_.find("Stack Size") != properties_.end()) {
-        std::string size = properties_["Stack Size"];
-        if (size.find("/") != std::string::npos) {
-            size = size.substr(0, size.find("/"));
-            count_ = std::stoi(size);
-        }
-    }
+    const ItemNumericProperty *stack_size = property("Stack Size");
+    if (stack_size && stack_size->numeric && stack_size->text.find("/") != std::string::npos)
+        count_ = static_cast<int>(stack_size->min);
+
+    CalculateDPS();
 
     has_mtx_ = json.HasMember("cosmeticMods");
 
@@ -280,33 +375,42 @@ Item::Item(const rapidjson::Value &json) :
     GenerateMods(json);
 }
 
-std::string Item::PrettyName() const {
-    if (!name_.empty())
-        return name_ + " " + typeLine_;
-    return typeLine_;
+const ItemMods &Item::text_mods(const std::string &type) const {
+    static const ItemMods kNone;
+    for (size_t i = 0; i < ITEM_MOD_TYPES.size() && i < text_mods_.size(); ++i)
+        if (ITEM_MOD_TYPES[i] == type)
+            return text_mods_[i];
+    return kNone;
 }
 
-double Item::DPS() const {
-    return pDPS() + eDPS();
+int Item::requirement(const InternedString &name) const {
+    // the last one wins if the API lists a requirement twice
+    int result = 0;
+    for (auto &requirement : text_requirements_)
+        if (requirement.name == name)
+            result = requirement.number;
+    return result;
 }
 
-double Item::pDPS() const {
-    if (!properties_.count("Physical Damage") || !properties_.count("Attacks per Second"))
-        return 0;
-    double aps = std::stod(properties_.at("Attacks per Second"));
-    std::string pd = properties_.at("Physical Damage");
-
-    return aps * Util::AverageDamage(pd);
+const ItemNumericProperty *Item::property(const InternedString &name) const {
+    for (auto &property : properties_)
+        if (property.name == name)
+            return &property;
+    return nullptr;
 }
 
-double Item::eDPS() const {
-    if (elemental_damage_.empty() || !properties_.count("Attacks per Second"))
-        return 0;
+void Item::CalculateDPS() {
+    const ItemNumericProperty *aps = property("Attacks per Second");
+    if (!aps || !aps->numeric)
+        return;
+    const ItemNumericProperty *pd = property("Physical Damage");
+    // only ranges count, same as Util::AverageDamage
+    if (pd && pd->numeric && pd->text.find("-") != std::string::npos)
+        pdps_ = aps->min * pd->average();
     double damage = 0;
     for (auto &x : elemental_damage_)
         damage += Util::AverageDamage(x.first);
-    double aps = std::stod(properties_.at("Attacks per Second"));
-    return aps * damage;
+    edps_ = aps->min * damage;
 }
 
 void Item::GenerateMods(const rapidjson::Value &json) {
@@ -315,44 +419,46 @@ void Item::GenerateMods(const rapidjson::Value &json) {
 }
 
 void Item::CalculateHash(const rapidjson::Value &json) {
-    std::string unique_old(name_ + "~" + typeLine_ + "~");
-    std::string unique_new = unique_old;
+    ItemHasher hasher;
+    auto add = [&hasher](const char *data, size_t size) { hasher.Add(data, size); };
+
+    if (has_raw_names(json)) {
+        add(json["name"].GetString(), json["name"].GetStringLength());
+        add("~", 1);
+        add(json["typeLine"].GetString(), json["typeLine"].GetStringLength());
+        add("~", 1);
+    } else {
+        hasher.Add(name_);
+        add("~", 1);
+        hasher.Add(typeLine_);
+        add("~", 1);
+    }
+    add_unique_fields(json, add);
+    add("~", 1);
+    hasher.Add(location_.GetUniqueHash());
 
-    if (json.HasMember("name") && json.HasMember("typeLine") && json["name"].IsString() && json["typeLine"].IsString())
-        unique_new = std::string(json["name"].GetString()) + "~" + json["typeLine"].GetString() + "~";
+    hash_ = hasher.Finish();
+}
 
+void Item::LegacyHashes(const rapidjson::Value &json, std::string *old_hash, std::string *hash) {
     std::string unique_common;
+    add_unique_fields(json, [&unique_common](const char *data, size_t size) { unique_common.append(data, size); });
 
-    if (json.HasMember("explicitMods") && json["explicitMods"].IsArray())
-        for (auto &mod : json["explicitMods"])
-            if (mod.IsString())
-                unique_common += std::string(mod.GetString()) + "~";
-
-    if (json.HasMember("implicitMods") && json["implicitMods"].IsArray())
-        for (auto &mod : json["implicitMods"])
-            if (mod.IsString())
-                unique_common += std::string(mod.GetString()) + "~";
-
-    unique_common += item_unique_properties(json, "properties") + "~";
-    unique_common += item_unique_properties(json, "additionalProperties") + "~";
-
-    if (json.HasMember("sockets") && json["sockets"].IsArray())
-        for (auto &socket : json["sockets"]) {
-            if (!socket.HasMember("group") || !socket.HasMember("attr") || !socket["group"].IsInt() || !socket["attr"].IsString())
-                continue;
-            unique_common += std::to_string(socket["group"].GetInt()) + "~" + socket["attr"].GetString() + "~";
-        }
+    std::string name, type_line;
+    if (json.HasMember("name") && json["name"].IsString())
+        name = json["name"].GetString();
+    if (json.HasMember("typeLine") && json["typeLine"].IsString())
+        type_line = json["typeLine"].GetString();
 
-    unique_old += unique_common;
-    unique_new += unique_common;
+    std::string unique_old = fixup_name(name) + "~" + fixup_name(type_line) + "~";
+    std::string unique_new = has_raw_names(json) ? name + "~" + type_line + "~" : unique_old;
 
-    old_hash_ = Util::Md5(unique_old);
-    unique_new += "~" + location_.GetUniqueHash();
-    hash_ = Util::Md5(unique_new);
+    *old_hash = Util::Md5(unique_old + unique_common);
+    *hash = Util::Md5(unique_new + unique_common + "~" + ItemLocation(json).GetUniqueHash());
 }
 
 bool Item::operator<(const Item &rhs) const {
-    std::string name = PrettyName();
-    std::string rhs_name = rhs.PrettyName();
+    const std::string &name = PrettyName();
+    const std::string &rhs_name = rhs.PrettyName();
     return std::tie(name,uid_,hash_) < std::tie(rhs_name, rhs.uid_, hash_);
 }
@@ -27,6 +27,10 @@
 #include <vector>
 #include "rapidjson/document.h"
 
+#include "internedstring.h"
+#include "itemarena.h"
+#include "itemhash.h"
+#include "itemjson.h"
 #include "itemconstants.h"
 #include "itemlocation.h"
 
@@ -41,15 +45,31 @@ struct ItemPropertyValue {
     int type;
 };
 
+// Names of properties and requirements are interned, there are only so many.  Their
+// values aren't, see InternedString.
 struct ItemProperty {
-    std::string name;
-    std::vector<ItemPropertyValue> values;
+    InternedString name;
+    ArenaVector<ItemPropertyValue> values;
     int display_mode;
 };
 
+// A property as the API sends it along with the number it starts with, parsed once
+// so filters, columns and sorting don't parse the text again
+struct ItemNumericProperty {
+    InternedString name;
+    std::string text;
+    // false if text doesn't start with a number, e.g. "Two Handed Sword"
+    bool numeric;
+    // "+20%" -> 20, "1.50" -> 1.5; both ends of damage ranges like "12-24"
+    double min, max;
+    double average() const { return (min + max) / 2; }
+};
+
 struct ItemRequirement {
-    std::string name;
+    InternedString name;
     ItemPropertyValue value;
+    // value as a number, 0 if it isn't one
+    int number;
 };
 
 struct ItemSocket {
@@ -57,51 +77,67 @@ struct ItemSocket {
     char attr;
 };
 
-typedef std::vector<std::string> ItemMods;
-typedef std::unordered_map<std::string, double> ModTable;
+typedef ArenaVector<std::string> ItemMods;
+// Generated mod and its value, see modlist.h.  Items only have a few, a flat vector
+// is one allocation where a hash table was several.
+typedef ArenaVector<std::pair<InternedString, double>> ModTable;
 
 class Item {
 public:
     typedef const std::unordered_map<std::string, std::string> CategoryReplaceMap;
 
-    explicit Item(const rapidjson::Value &json);
+    // Containers are allocated from arena if there is one, the heap otherwise.  Copies are on the heap.
+    explicit Item(const rapidjson::Value &json, std::shared_ptr<ItemArena> arena = nullptr);
+    // serialized must be json as text, for callers that have it already and don't want to serialize again
+    Item(const rapidjson::Value &json, ItemJson serialized, std::shared_ptr<ItemArena> arena = nullptr);
     Item(const std::string &name, const ItemLocation &location); // used by tests
-    std::string name() const { return name_; }
+    Item(const Item &other) = default;
+    // Containers keep their allocator when assigned to, they would outlive the arena they came from
+    Item &operator=(const Item &other) = delete;
+    const std::string &name() const { return name_; }
     std::string typeLine() const { return typeLine_; }
-    std::string PrettyName() const;
+    // Same as typeLine, compares as a pointer
+    const InternedString &type_line() const { return typeLine_; }
+    const std::string &PrettyName() const { return pretty_name_; }
     bool corrupted() const { return corrupted_; }
     bool identified() const { return identified_; }
     int w() const { return w_; }
     int h() const { return h_; }
     int frameType() const { return frameType_; }
     const std::string &icon() const { return icon_; }
-    const std::map<std::string, std::string> &properties() const { return properties_; }
-    const std::vector<ItemProperty> &text_properties() const { return text_properties_; }
-    const std::vector<ItemRequirement> &text_requirements() const { return text_requirements_; }
-    const std::map<std::string, ItemMods> &text_mods() const { return text_mods_; }
-    const std::vector<ItemSocket> &text_sockets() const { return text_sockets_; }
-    const std::string &hash() const { return hash_; }
-    const std::string &old_hash() const { return old_hash_; }
-    const std::vector<std::pair<std::string, int>> &elemental_damage() const { return elemental_damage_; }
-    const std::map<std::string, int> &requirements() const { return requirements_; }
-    double DPS() const;
-    double pDPS() const;
-    double eDPS() const;
+    const ArenaVector<ItemNumericProperty> &properties() const { return properties_; }
+    // nullptr if the item doesn't have the property
+    const ItemNumericProperty *property(const InternedString &name) const;
+    const ArenaVector<ItemProperty> &text_properties() const { return text_properties_; }
+    const ArenaVector<ItemRequirement> &text_requirements() const { return text_requirements_; }
+    // type is one of ITEM_MOD_TYPES
+    const ItemMods &text_mods(const std::string &type) const;
+    const ArenaVector<ItemSocket> &text_sockets() const { return text_sockets_; }
+    const ItemHash &hash() const { return hash_; }
+    const ArenaVector<std::pair<std::string, int>> &elemental_damage() const { return elemental_damage_; }
+    // 0 if the item doesn't require it
+    int requirement(const InternedString &name) const;
+    double DPS() const { return pdps_ + edps_; }
+    double pDPS() const { return pdps_; }
+    double eDPS() const { return edps_; }
     int sockets_cnt() const { return sockets_cnt_; }
     int links_cnt() const { return links_cnt_; }
     const ItemSocketGroup &sockets() const { return sockets_; }
-    const std::vector<ItemSocketGroup> &socket_groups() const { return socket_groups_; }
+    const ArenaVector<ItemSocketGroup> &socket_groups() const { return socket_groups_; }
     const ItemLocation &location() const { return location_; }
-    const std::string& json() { return json_; };
+    const ItemJson &json() const { return json_; };
     const std::string& note() const { return note_; };
     const std::string& category() const { return category_; };
-    const std::vector<std::string>& category_vector() const { return category_vector_; };
+    const ArenaVector<InternedString>& category_vector() const { return category_vector_; };
     uint talisman_tier() const { return talisman_tier_; };
     int count() const { return count_; };
     bool has_mtx() const { return has_mtx_; }
     const ModTable &mod_table() const { return mod_table_; }
     int ilvl() const { return ilvl_; }
     bool operator<(const Item &other) const;
+    // MD5 keys of older versions, old_hash before db_version 2 and hash until 3.  Only
+    // needed to migrate buyouts, json has to include the location like json() does.
+    static void LegacyHashes(const rapidjson::Value &json, std::string *old_hash, std::string *hash);
     static const size_t k_CategoryLevels = 3;
     static const std::array<CategoryReplaceMap, k_CategoryLevels> replace_map_;
 
@@ -110,33 +146,41 @@ private:
     // For now it only does that for a small chosen subset of mods (think "popular" + "pseudo" sections at poe.trade)
     void GenerateMods(const rapidjson::Value &json);
     void CalculateHash(const rapidjson::Value &json);
+    void CalculateDPS();
 
+    // Shared by the items of a reply.  Declared first, the containers below may be
+    // allocated from it and have to go before it does.
+    std::shared_ptr<ItemArena> arena_;
     std::string name_;
     ItemLocation location_;
-    std::string typeLine_;
-    std::string category_;
-    std::vector<std::string> category_vector_;
+    InternedString typeLine_;
+    std::string pretty_name_;
+    InternedString category_;
+    ArenaVector<InternedString> category_vector_;
     bool corrupted_;
     bool identified_;
     int w_, h_;
     int frameType_;
-    std::string icon_;
-    std::map<std::string, std::string> properties_;
-    std::string old_hash_, hash_;
+    InternedString icon_;
+    // in the order the API lists them, there are only a few per item
+    ArenaVector<ItemNumericProperty> properties_;
+    // Murmur3 of the bytes the MD5 hash used to be taken over
+    ItemHash hash_;
     // vector of pairs [damage, type]
-    std::vector<std::pair<std::string, int>> elemental_damage_;
+    ArenaVector<std::pair<std::string, int>> elemental_damage_;
     int sockets_cnt_, links_cnt_;
     ItemSocketGroup sockets_;
-    std::vector<ItemSocketGroup> socket_groups_;
-    std::map<std::string, int> requirements_;
-    std::string json_;
+    ArenaVector<ItemSocketGroup> socket_groups_;
+    ItemJson json_;
     int count_;
+    double pdps_{0}, edps_{0};
     bool has_mtx_;
     int ilvl_;
-    std::vector<ItemProperty> text_properties_;
-    std::vector<ItemRequirement> text_requirements_;
-    std::map<std::string, ItemMods> text_mods_;
-    std::vector<ItemSocket> text_sockets_;
+    ArenaVector<ItemProperty> text_properties_;
+    ArenaVector<ItemRequirement> text_requirements_;
+    // same order as ITEM_MOD_TYPES
+    ArenaVector<ItemMods> text_mods_;
+    ArenaVector<ItemSocket> text_sockets_;
     std::string note_;
     ModTable mod_table_;
     std::string uid_;
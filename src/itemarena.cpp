@@ -0,0 +1,52 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "itemarena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+const size_t ItemArena::k_MaxBlockSize;
+
+ItemArena::~ItemArena() {
+    while (blocks_) {
+        Block *next = blocks_->next;
+        ::operator delete(blocks_);
+        blocks_ = next;
+    }
+}
+
+void *ItemArena::Allocate(size_t size, size_t alignment) {
+    // Block headers are aligned for anything, padding only depends on what came before in the block
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(current_) + alignment - 1) & ~(alignment - 1);
+    if (!current_ || aligned + size > reinterpret_cast<uintptr_t>(end_)) {
+        size_t header = (sizeof(Block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+        size_t capacity = std::max(block_size_, size + alignment);
+        Block *block = static_cast<Block*>(::operator new(header + capacity));
+        block->next = blocks_;
+        blocks_ = block;
+        current_ = reinterpret_cast<char*>(block) + header;
+        end_ = current_ + capacity;
+        block_size_ = std::min(block_size_ * 2, k_MaxBlockSize);
+        aligned = (reinterpret_cast<uintptr_t>(current_) + alignment - 1) & ~(alignment - 1);
+    }
+    current_ = reinterpret_cast<char*>(aligned + size);
+    return reinterpret_cast<void*>(aligned);
+}
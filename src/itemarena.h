@@ -0,0 +1,93 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Monotonic arena for the small containers of the items of one reply.  Those
+ * items are created and dropped together, so their containers are carved out
+ * of a few blocks shared through a shared_ptr and freed with the last of them,
+ * instead of being a dozen separate allocations per item.  Nothing is freed
+ * before that: a container that grows leaves its old buffer behind, so they
+ * should be reserved to their final size.
+ *
+ * Not thread safe, a reply is read on one thread.
+ */
+class ItemArena {
+public:
+    ItemArena() {}
+    ~ItemArena();
+    ItemArena(const ItemArena&) = delete;
+    ItemArena &operator=(const ItemArena&) = delete;
+    void *Allocate(size_t size, size_t alignment);
+private:
+    struct Block {
+        Block *next;
+    };
+    // room in the newest block
+    char *current_{nullptr};
+    char *end_{nullptr};
+    Block *blocks_{nullptr};
+    // of the next block, doubles every time up to k_MaxBlockSize
+    size_t block_size_{4 * 1024};
+    static const size_t k_MaxBlockSize = 256 * 1024;
+};
+
+// Allocates from an ItemArena, or the heap without one.  Doesn't own the arena, Item does.
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator(ItemArena *arena = nullptr) : arena_(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena()) {}
+
+    T *allocate(size_t n) {
+        if (!arena_)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *p, size_t) {
+        if (!arena_)
+            ::operator delete(p);
+    }
+    // Copies may outlive the arena, they go to the heap
+    ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+    ItemArena *arena() const { return arena_; }
+private:
+    ItemArena *arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) { return lhs.arena() == rhs.arena(); }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) { return lhs.arena() != rhs.arena(); }
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,157 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "itemhash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const uint64_t kC1 = 0x87c37b91114253d5ULL;
+const uint64_t kC2 = 0x4cf5ad432745937fULL;
+
+inline uint64_t Rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// Little endian regardless of the platform so hashes can be stored
+inline uint64_t Read64(const unsigned char *p) {
+    uint64_t result = 0;
+    for (int i = 7; i >= 0; --i)
+        result = (result << 8) | p[i];
+    return result;
+}
+
+int HexDigit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+}
+
+std::string ItemHash::ToHex() const {
+    static const char kDigits[] = "0123456789abcdef";
+    std::string result(32, '0');
+    const uint64_t halves[] = { h1, h2 };
+    for (int half = 0; half < 2; ++half)
+        for (int i = 0; i < 8; ++i) {
+            unsigned byte = (halves[half] >> (8 * i)) & 0xff;
+            result[half * 16 + i * 2] = kDigits[byte >> 4];
+            result[half * 16 + i * 2 + 1] = kDigits[byte & 0xf];
+        }
+    return result;
+}
+
+bool ItemHash::FromHex(const std::string &hex, ItemHash *hash) {
+    if (hex.size() != 32)
+        return false;
+    uint64_t halves[] = { 0, 0 };
+    for (int half = 0; half < 2; ++half)
+        for (int i = 0; i < 8; ++i) {
+            int high = HexDigit(hex[half * 16 + i * 2]);
+            int low = HexDigit(hex[half * 16 + i * 2 + 1]);
+            if (high < 0 || low < 0)
+                return false;
+            halves[half] |= static_cast<uint64_t>(high * 16 + low) << (8 * i);
+        }
+    hash->h1 = halves[0];
+    hash->h2 = halves[1];
+    return true;
+}
+
+ItemHasher::ItemHasher(uint32_t seed) :
+    h1_(seed),
+    h2_(seed)
+{}
+
+void ItemHasher::Block(const unsigned char *block) {
+    uint64_t k1 = Read64(block);
+    uint64_t k2 = Read64(block + 8);
+
+    k1 *= kC1; k1 = Rotl(k1, 31); k1 *= kC2; h1_ ^= k1;
+    h1_ = Rotl(h1_, 27); h1_ += h2_; h1_ = h1_ * 5 + 0x52dce729;
+
+    k2 *= kC2; k2 = Rotl(k2, 33); k2 *= kC1; h2_ ^= k2;
+    h2_ = Rotl(h2_, 31); h2_ += h1_; h2_ = h2_ * 5 + 0x38495ab5;
+}
+
+void ItemHasher::Add(const char *data, size_t size) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+    length_ += size;
+    if (tail_size_ > 0) {
+        size_t take = std::min(size, sizeof(tail_) - tail_size_);
+        memcpy(tail_ + tail_size_, bytes, take);
+        tail_size_ += take;
+        bytes += take;
+        size -= take;
+        if (tail_size_ < sizeof(tail_))
+            return;
+        Block(tail_);
+        tail_size_ = 0;
+    }
+    for (; size >= sizeof(tail_); bytes += sizeof(tail_), size -= sizeof(tail_))
+        Block(bytes);
+    memcpy(tail_, bytes, size);
+    tail_size_ = size;
+}
+
+ItemHash ItemHasher::Finish() const {
+    uint64_t h1 = h1_, h2 = h2_;
+    uint64_t k1 = 0, k2 = 0;
+    for (size_t i = tail_size_; i > 8; --i)
+        k2 = (k2 << 8) | tail_[i - 1];
+    for (size_t i = std::min<size_t>(tail_size_, 8); i > 0; --i)
+        k1 = (k1 << 8) | tail_[i - 1];
+    if (tail_size_ > 8) {
+        k2 *= kC2; k2 = Rotl(k2, 33); k2 *= kC1; h2 ^= k2;
+    }
+    if (tail_size_ > 0) {
+        k1 *= kC1; k1 = Rotl(k1, 31); k1 *= kC2; h1 ^= k1;
+    }
+
+    h1 ^= length_;
+    h2 ^= length_;
+    h1 += h2;
+    h2 += h1;
+    h1 = Fmix(h1);
+    h2 = Fmix(h2);
+    h1 += h2;
+    h2 += h1;
+
+    ItemHash result;
+    result.h1 = h1;
+    result.h2 = h2;
+    return result;
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 128-bit identity of an item, keys buyouts
+struct ItemHash {
+    uint64_t h1{0}, h2{0};
+    // 32 hex digits, bytes in the order the reference MurmurHash3_x64_128 writes them
+    std::string ToHex() const;
+    // False unless hex is exactly 32 hex digits.  Also reads MD5 keys of older versions.
+    static bool FromHex(const std::string &hex, ItemHash *hash);
+};
+
+inline bool operator==(const ItemHash &lhs, const ItemHash &rhs) { return lhs.h1 == rhs.h1 && lhs.h2 == rhs.h2; }
+inline bool operator!=(const ItemHash &lhs, const ItemHash &rhs) { return !(lhs == rhs); }
+inline bool operator<(const ItemHash &lhs, const ItemHash &rhs) {
+    return lhs.h1 < rhs.h1 || (lhs.h1 == rhs.h1 && lhs.h2 < rhs.h2);
+}
+
+/*
+ * MurmurHash3 x64 128-bit fed piece by piece, so an item's fields can be hashed
+ * as they're read instead of being concatenated first.  Hashing "ab" then "c"
+ * gives the same result as hashing "abc".
+ */
+class ItemHasher {
+public:
+    explicit ItemHasher(uint32_t seed = 0);
+    void Add(const char *data, size_t size);
+    void Add(const std::string &data) { Add(data.data(), data.size()); }
+    ItemHash Finish() const;
+private:
+    void Block(const unsigned char *block);
+
+    uint64_t h1_, h2_;
+    unsigned char tail_[16];
+    size_t tail_size_{0};
+    uint64_t length_{0};
+};
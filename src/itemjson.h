@@ -0,0 +1,64 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <string>
+
+/*
+ * Text of an item's JSON that doesn't own a copy of it.  It's a piece of a shared
+ * buffer, usually the reply the item came in, followed by a suffix shared by all
+ * items of that reply.  Both are implicitly shared QByteArrays, so the buffer
+ * lives for as long as any item still refers to it and is freed with the last one.
+ */
+class ItemJson {
+public:
+    ItemJson() {}
+    explicit ItemJson(const std::string &text) :
+        buffer_(QByteArray::fromStdString(text)),
+        size_(buffer_.size())
+    {}
+    // buffer[offset, offset + size) followed by suffix, neither is copied
+    ItemJson(const QByteArray &buffer, int offset, int size, const QByteArray &suffix = QByteArray()) :
+        buffer_(buffer),
+        suffix_(suffix),
+        offset_(offset),
+        size_(size)
+    {}
+    int size() const { return size_ + suffix_.size(); }
+    bool empty() const { return size() == 0; }
+    void AppendTo(std::string *out) const {
+        out->append(buffer_.constData() + offset_, size_);
+        out->append(suffix_.constData(), suffix_.size());
+    }
+    // Copies the text, for the rare callers that need it in one piece
+    std::string str() const {
+        std::string text;
+        text.reserve(size());
+        AppendTo(&text);
+        return text;
+    }
+private:
+    QByteArray buffer_;
+    QByteArray suffix_;
+    int offset_{0};
+    int size_{0};
+};
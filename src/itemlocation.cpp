@@ -93,12 +93,12 @@ QRectF ItemLocation::GetRect() const {
 
     if ((!inventory_id_.empty()) && (type_ == ItemLocationType::CHARACTER)) {
         if (inventory_id_ == "MainInventory") {
-            itemPos.y += POS_MAP.at(inventory_id_).y;
+            itemPos.y += POS_MAP.at(inventory_id_.str()).y;
         } else if (inventory_id_ == "Flask") {
-            itemPos.x += POS_MAP.at(inventory_id_).x;
-            itemPos.y = POS_MAP.at(inventory_id_).y;
-        } else if (POS_MAP.count(inventory_id_)) {
-            itemPos = POS_MAP.at(inventory_id_);
+            itemPos.x += POS_MAP.at(inventory_id_.str()).x;
+            itemPos.y = POS_MAP.at(inventory_id_.str()).y;
+        } else if (POS_MAP.count(inventory_id_.str())) {
+            itemPos = POS_MAP.at(inventory_id_.str());
         }
     }
 
@@ -3,6 +3,7 @@
 #include <QRectF>
 #include "rapidjson/document.h"
 
+#include "internedstring.h"
 #include "itemconstants.h"
 #include "rapidjson_util.h"
 
@@ -27,6 +28,7 @@ public:
     void set_type(const ItemLocationType type) { type_ = type; }
     ItemLocationType get_type() const { return type_; }
     void set_character(const std::string &character) { character_ = character; }
+    std::string get_character() const { return character_; }
     void set_tab_id(int tab_id) { tab_id_ = tab_id; }
     void set_tab_label(const std::string &tab_label) { tab_label_ = tab_label; }
     std::string get_tab_label() const { return tab_label_; }
@@ -38,7 +40,7 @@ private:
     bool socketed_;
     ItemLocationType type_;
     int tab_id_{0};
-    std::string tab_label_;
-    std::string character_;
-    std::string inventory_id_;
+    InternedString tab_label_;
+    InternedString character_;
+    InternedString inventory_id_;
 };
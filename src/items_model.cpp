@@ -19,16 +19,20 @@
 
 #include "items_model.h"
 
+#include <QColor>
+
 #include "application.h"
 #include "bucket.h"
 #include "buyoutmanager.h"
 #include "itemlocation.h"
+#include "itemsmanager.h"
 #include "search.h"
 #include "util.h"
 #include "QsLog.h"
 
-ItemsModel::ItemsModel(BuyoutManager &bo_manager, const Search &search) :
+ItemsModel::ItemsModel(BuyoutManager &bo_manager, const ItemsManager &items_manager, const Search &search) :
     bo_manager_(bo_manager),
+    items_manager_(items_manager),
     search_(search)
 {
 }
@@ -102,6 +106,12 @@ QVariant ItemsModel::data(const QModelIndex &index, int role) const {
                 title += QString(" [%1]").arg(bo.AsText().c_str());
             return title;
         }
+        if (location.IsValid() && items_manager_.stale(location)) {
+            if (role == Qt::ForegroundRole)
+                return QColor(Qt::gray);
+            if (role == Qt::ToolTipRole)
+                return "Showing items from the last update while this location is being refreshed";
+        }
         return QVariant();
     }
     auto &column = search_.columns()[index.column()];
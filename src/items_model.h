@@ -25,12 +25,13 @@
 #include "item.h"
 
 class BuyoutManager;
+class ItemsManager;
 class Search;
 
 class ItemsModel : public QAbstractItemModel {
     Q_OBJECT
 public:
-    ItemsModel(BuyoutManager &bo_manager, const Search &search);
+    ItemsModel(BuyoutManager &bo_manager, const ItemsManager &items_manager, const Search &search);
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
     int columnCount(const QModelIndex &parent = QModelIndex()) const;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
@@ -44,9 +45,15 @@ public:
     Qt::SortOrder GetSortOrder() { return sort_order_;};
     int GetSortColumn() { return sort_column_;};
     void SetSorted(bool val) { sorted_ = val; };
+    bool IsSorted() const { return sorted_; }
 
 private:
+    // Search changes buckets in place on per-location updates and needs to
+    // announce row insertions/removals to the views
+    friend class Search;
+
     BuyoutManager &bo_manager_;
+    const ItemsManager &items_manager_;
     const Search &search_;
     Qt::SortOrder sort_order_{Qt::DescendingOrder};
     int sort_column_{0};
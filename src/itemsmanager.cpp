@@ -20,6 +20,7 @@
 #include "itemsmanager.h"
 
 #include <QThread>
+#include <algorithm>
 #include <stdexcept>
 
 #include "application.h"
@@ -57,12 +58,24 @@ void ItemsManager::Start() {
     connect(thread_.get(), SIGNAL(started()), worker_.get(), SLOT(Init()));
     connect(this, SIGNAL(UpdateSignal(TabSelection::Type, const std::vector<ItemLocation> &)), worker_.get(), SLOT(Update(TabSelection::Type, const std::vector<ItemLocation> &)));
     connect(worker_.get(), &ItemsManagerWorker::StatusUpdate, this, &ItemsManager::OnStatusUpdate);
-    connect(worker_.get(), SIGNAL(ItemsRefreshed(Items, std::vector<ItemLocation>, bool)), this, SLOT(OnItemsRefreshed(Items, std::vector<ItemLocation>, bool)));
+    connect(worker_.get(), SIGNAL(ItemsRefreshed(Items, std::vector<ItemLocation>, bool, bool)), this, SLOT(OnItemsRefreshed(Items, std::vector<ItemLocation>, bool, bool)));
+    connect(worker_.get(), SIGNAL(LocationRefreshed(ItemLocation, Items)), this, SLOT(OnLocationRefreshed(ItemLocation, Items)));
+    connect(worker_.get(), SIGNAL(LocationsStale(std::vector<ItemLocation>)), this, SLOT(OnLocationsStale(std::vector<ItemLocation>)));
+    connect(worker_.get(), SIGNAL(LocationRevalidated(ItemLocation)), this, SLOT(OnLocationRevalidated(ItemLocation)));
     worker_->moveToThread(thread_.get());
     thread_->start();
 }
 
+TabCache &ItemsManager::tab_cache() {
+    return worker_->tab_cache();
+}
+
 void ItemsManager::OnStatusUpdate(const CurrentStatusUpdate &status) {
+    if (status.state == ProgramState::UpdateCancelled) {
+        // Nothing is going to revalidate the rest, last known items is all there is
+        stale_.clear();
+        emit LocationStaleChanged(ItemLocation());
+    }
     emit StatusUpdate(status);
 }
 
@@ -88,9 +101,13 @@ void ItemsManager::ApplyAutoTabBuyouts() {
 }
 
 void ItemsManager::ApplyAutoItemBuyouts() {
+    ApplyAutoItemBuyouts(items_);
+}
+
+void ItemsManager::ApplyAutoItemBuyouts(const Items &items) {
     // Loop over all items, check for note field with pricing and apply
     auto &bo = app_.buyout_manager();
-    for (auto const& item: items_) {
+    for (auto const& item: items) {
         auto const &note = item->note();
         if (!note.empty()) {
             Buyout buyout = bo.StringToBuyout(note);
@@ -111,9 +128,13 @@ void ItemsManager::ApplyAutoItemBuyouts() {
 }
 
 void ItemsManager::PropagateTabBuyouts() {
+    app_.buyout_manager().ClearRefreshLocks();
+    PropagateTabBuyouts(items_);
+}
+
+void ItemsManager::PropagateTabBuyouts(const Items &items) {
     auto &bo = app_.buyout_manager();
-    bo.ClearRefreshLocks();
-    for (auto &item_ptr : items_) {
+    for (auto &item_ptr : items) {
         Item &item = *item_ptr;
         std::string hash = item.location().GetUniqueHash();
         auto item_bo = bo.Get(item);
@@ -139,11 +160,23 @@ void ItemsManager::PropagateTabBuyouts() {
     }
 }
 
-void ItemsManager::OnItemsRefreshed(const Items &items, const std::vector<ItemLocation> &tabs, bool initial_refresh) {
+const ItemStore &ItemsManager::store() {
+    if (!store_)
+        store_ = std::make_unique<ItemStore>(items_);
+    return *store_;
+}
+
+void ItemsManager::OnItemsRefreshed(const Items &items, const std::vector<ItemLocation> &tabs, bool initial_refresh, bool complete) {
     items_ = items;
+    store_.reset();
+    stale_.clear();
 
     bo_manager_.SetStashTabLocations(tabs);
-    MigrateBuyouts();
+    MigrateBuyouts(items_);
+    // Items that weren't loaded still have their buyouts under the legacy keys, they're
+    // migrated as they show up again
+    if (complete && data_.GetInt("db_version") != 3)
+        data_.SetInt("db_version", 3);
     ApplyAutoTabBuyouts();
     ApplyAutoItemBuyouts();
     PropagateTabBuyouts();
@@ -152,6 +185,37 @@ void ItemsManager::OnItemsRefreshed(const Items &items, const std::vector<ItemLo
     emit ItemsRefreshed(initial_refresh);
 }
 
+void ItemsManager::OnLocationRefreshed(const ItemLocation &location, const Items &items) {
+    // ItemLocation comparison only looks at the tab index or character name,
+    // which is exactly what identifies the items that are being replaced
+    items_.erase(std::remove_if(items_.begin(), items_.end(), [&location](const std::shared_ptr<Item> &item) {
+        return !(item->location() < location) && !(location < item->location());
+    }), items_.end());
+    items_.insert(items_.end(), items.begin(), items.end());
+    store_.reset();
+
+    // Tab buyouts, refresh locks and categories are recalculated from scratch once the
+    // whole update is done, only deal with what is needed to display these items right.
+    // Buyouts are migrated here too in case the initial refresh didn't have these items.
+    MigrateBuyouts(items);
+    ApplyAutoItemBuyouts(items);
+    PropagateTabBuyouts(items);
+    stale_.erase(location.GetUniqueHash());
+
+    emit LocationRefreshed(location, items);
+}
+
+void ItemsManager::OnLocationsStale(const std::vector<ItemLocation> &locations) {
+    for (auto &location : locations)
+        stale_.insert(location.GetUniqueHash());
+    emit LocationStaleChanged(ItemLocation());
+}
+
+void ItemsManager::OnLocationRevalidated(const ItemLocation &location) {
+    stale_.erase(location.GetUniqueHash());
+    emit LocationStaleChanged(location);
+}
+
 void ItemsManager::UpdateCategories() {
     categories_.clear();
     for (auto const &item: items_) {
@@ -190,13 +254,20 @@ void ItemsManager::OnAutoRefreshTimer() {
     Update(TabSelection::Checked);
 }
 
-void ItemsManager::MigrateBuyouts() {
+void ItemsManager::MigrateBuyouts(const Items &items) {
     int db_version = data_.GetInt("db_version");
     // Don't migrate twice
-    if (db_version == 2)
+    if (db_version == 3)
         return;
-    for (auto &item : items_)
-        bo_manager_.MigrateItem(*item);
+    // Buyouts are keyed by the MD5 hash of version 2 or, before that, the old one.  The
+    // legacy keys aren't kept in items, so their json is parsed once more just for this.
+    for (auto &item : items) {
+        rapidjson::Document doc;
+        if (item->json().empty() || doc.Parse(item->json().str().c_str()).HasParseError() || !doc.IsObject())
+            continue;
+        std::string old_hash, hash;
+        Item::LegacyHashes(doc, &old_hash, &hash);
+        bo_manager_.MigrateItem(*item, db_version == 2 ? hash : old_hash);
+    }
     bo_manager_.Save();
-    data_.SetInt("db_version", 2);
 }
@@ -21,9 +21,12 @@
 
 #include <QTimer>
 #include <memory>
+#include <set>
+#include <string>
 
 #include "item.h"
 #include "itemsmanagerworker.h"
+#include "itemstore.h"
 #include "tabcache.h"
 
 struct CurrentStatusUpdate;
@@ -32,6 +35,7 @@ class Application;
 class BuyoutManager;
 class DataStore;
 class ItemsManagerWorker;
+class TabCache;
 class Shop;
 
 /*
@@ -51,23 +55,41 @@ public:
     int auto_update_interval() const { return auto_update_interval_; }
     bool auto_update() const { return auto_update_; }
     const Items &items() const { return items_; }
+    // Columns of items(), built when first asked for after the items changed
+    const ItemStore &store();
+    // Owned by the worker thread, only its diagnostics are safe to use from elsewhere
+    TabCache &tab_cache();
     void ApplyAutoTabBuyouts();
     void ApplyAutoItemBuyouts();
     void PropagateTabBuyouts();
+    void ApplyAutoItemBuyouts(const Items &items);
+    void PropagateTabBuyouts(const Items &items);
     void UpdateCategories();
     const QSet<QString>& categories() const { return categories_; };
+    // Stale locations show what the last update found while they're being refreshed
+    bool stale(const ItemLocation &location) const { return stale_.count(location.GetUniqueHash()) > 0; }
 public slots:
     // called by auto_update_timer_
     void OnAutoRefreshTimer();
     // Used to glue Worker's signals to MainWindow
     void OnStatusUpdate(const CurrentStatusUpdate &status);
-    void OnItemsRefreshed(const Items &items, const std::vector<ItemLocation> &tabs, bool initial_refresh);
+    // Buyouts only move to the current item hash for good once a complete load saw every item, see MigrateBuyouts
+    void OnItemsRefreshed(const Items &items, const std::vector<ItemLocation> &tabs, bool initial_refresh, bool complete = true);
+    // Replaces items of a single location while an update is still in progress
+    void OnLocationRefreshed(const ItemLocation &location, const Items &items);
+    // Marks locations whose items are only what the last update found, until they're received again
+    void OnLocationsStale(const std::vector<ItemLocation> &locations);
+    void OnLocationRevalidated(const ItemLocation &location);
 signals:
     void UpdateSignal(TabSelection::Type type, const std::vector<ItemLocation>& tab_names = std::vector<ItemLocation>());
     void ItemsRefreshed(bool initial_refresh);
+    void LocationRefreshed(const ItemLocation &location, const Items &items);
+    // Stale mark of the location changed, an invalid location means any of them
+    void LocationStaleChanged(const ItemLocation &location);
     void StatusUpdate(const CurrentStatusUpdate &status);
 private:
-    void MigrateBuyouts();
+    // Moves buyouts of these items from the hashes of older versions, until the database is at version 3
+    void MigrateBuyouts(const Items &items);
 
     // should items be automatically refreshed
     bool auto_update_;
@@ -81,5 +103,8 @@ private:
     Shop &shop_;
     Application &app_;
     Items items_;
+    std::unique_ptr<ItemStore> store_;
     QSet<QString> categories_;
+    // GetUniqueHash of the stale locations
+    std::set<std::string> stale_;
 };
@@ -19,6 +19,7 @@
 
 #include "itemsmanagerworker.h"
 
+#include <QDateTime>
 #include <QNetworkAccessManager>
 #include <QNetworkCookie>
 #include <QNetworkCookieJar>
@@ -28,6 +29,7 @@
 #include <QTimer>
 #include <QUrlQuery>
 #include <algorithm>
+#include <tuple>
 #include "rapidjson/document.h"
 #include "rapidjson/error/en.h"
 
@@ -39,11 +41,42 @@
 #include "mainwindow.h"
 #include "buyoutmanager.h"
 #include "filesystem.h"
-
-const char *kStashItemsUrl = "https://www.pathofexile.com/character-window/get-stash-items";
-const char *kCharacterItemsUrl = "https://www.pathofexile.com/character-window/get-items";
-const char *kGetCharactersUrl = "https://www.pathofexile.com/character-window/get-characters";
-const char *kMainPage = "https://www.pathofexile.com/";
+#include "stashreplyreader.h"
+
+const char *kStashItemsPath = "/character-window/get-stash-items";
+const char *kCharacterItemsPath = "/character-window/get-items";
+const char *kGetCharactersPath = "/character-window/get-characters";
+const char *kMainPagePath = "/";
+
+// Where all of the above live, tests point this to a local server
+static std::string api_root = "https://www.pathofexile.com";
+
+// Request priorities, lower values are fetched first
+const int kPrioritySelected = 0;
+const int kPriorityRefresh = 1;
+const int kPriorityStale = 2;
+// The active character goes last so that the update leaves it selected in game
+const int kPriorityActiveCharacter = 3;
+
+// Tabs changing over and over again during one update means the user is busy with them,
+// give up instead of chasing the tab list.
+const int kMaxTabResyncs = 3;
+
+// Failed attempts at fetching the tab list once the update is done before giving up on it.  Other
+// than rate limiting, which the limiter waits out, every failure waits twice as long as the last.
+const int kMaxTabListVerifies = 5;
+const int kTabListRetryMsecs = 1000;
+
+// Tab requests don't ask for the tab list, except for every this many to notice changes early.
+// The list is always checked once more when everything else is done, see VerifyTabList.
+const int kTabListSampleInterval = 20;
+
+// Deterministic order of the item list the rest of the application sees, see FinishUpdate
+static void SortItems(Items *items) {
+    std::sort(items->begin(), items->end(), [](const std::shared_ptr<Item> &a, const std::shared_ptr<Item> &b){
+        return *a < *b;
+    });
+}
 
 ItemsManagerWorker::ItemsManagerWorker(Application &app, QThread *thread) :
     data_(app.data()),
@@ -53,12 +86,16 @@ ItemsManagerWorker::ItemsManagerWorker(Application &app, QThread *thread) :
     bo_manager_(app.buyout_manager()),
     account_name_(app.email())
 {
-    QUrl poe(kMainPage);
+    QUrl poe(ApiUrl(kMainPagePath));
+    rate_limiter_ = RateLimiter::ForAccount(account_name_);
+    character_limiter_ = RateLimiter::ForAccount(account_name_, "characters");
 
     QDir cache_path{std::string{Filesystem::UserDir() + "/tabcache/" + account_name_ + "/" + league_}.c_str()};
 
     QLOG_DEBUG() << "Cache directory: " << cache_path.path();
 
+    // Replies are stored once for all accounts and leagues, the directory above only holds the index
+    tab_cache_->SetObjectDirectory(QString::fromStdString(Filesystem::UserDir() + "/tabcache/objects"));
     tab_cache_->setCacheDirectory(cache_path.path());
     tab_cache_->setMaximumCacheSize(kMaxCacheSize);
 
@@ -66,6 +103,19 @@ ItemsManagerWorker::ItemsManagerWorker(Application &app, QThread *thread) :
     network_manager_.setCache(tab_cache_);
     network_manager_.cookieJar()->setCookiesFromUrl(app.logged_in_nm().cookieJar()->cookiesForUrl(poe), poe);
     network_manager_.moveToThread(thread);
+
+    connect(&parser_, SIGNAL(ParseFinished(std::shared_ptr<ParsedReply>)),
+            this, SLOT(OnTabParsed(std::shared_ptr<ParsedReply>)), Qt::QueuedConnection);
+    connect(&parser_, SIGNAL(StoredParseFinished(std::shared_ptr<ParsedReply>)),
+            this, SLOT(OnStoredParsed(std::shared_ptr<ParsedReply>)), Qt::QueuedConnection);
+}
+
+void ItemsManagerWorker::SetApiRoot(const std::string &root) {
+    api_root = root;
+}
+
+QUrl ItemsManagerWorker::ApiUrl(const char *path) {
+    return QUrl((api_root + path).c_str());
 }
 
 ItemsManagerWorker::~ItemsManagerWorker() {
@@ -75,14 +125,6 @@ ItemsManagerWorker::~ItemsManagerWorker() {
 
 void ItemsManagerWorker::Init() {
     items_.clear();
-    std::string items = data_.Get("items");
-    if (items.size() != 0) {
-        rapidjson::Document doc;
-        doc.Parse(items.c_str());
-        for (auto item = doc.Begin(); item != doc.End(); ++item)
-            items_.push_back(std::make_shared<Item>(*item));
-    }
-
     tabs_.clear();
     std::string tabs = data_.Get("tabs");
     tabs_signature_ = CreateTabsSignatureVector(tabs);
@@ -93,6 +135,7 @@ void ItemsManagerWorker::Init() {
                 << rapidjson::GetParseError_En(doc.GetParseError());
             return;
         }
+        tab_hashes_ = TabParser::CreateTabHashes(doc);
         for (auto &tab : doc) {
             if (!tab.HasMember("n") || !tab["n"].IsString()) {
                 QLOG_ERROR() << "Malformed tabs data:" << tabs.c_str() << "Tab doesn't contain its name (field 'n').";
@@ -104,11 +147,184 @@ void ItemsManagerWorker::Init() {
                 tabs_.push_back(ItemLocation(index, tab["n"].GetString()));
         }
     }
-    emit ItemsRefreshed(items_, tabs_, true);
+
+    load_timer_.start();
+    load_allocations_ = AllocationStats::Current();
+    load_failed_ = false;
+    load_incomplete_ = false;
+    fingerprints_.clear();
+    stored_fingerprints_.clear();
+    // Every location is built on the pool and shown as soon as it's there
+    std::vector<StoredLocation> locations = data_.GetLocations();
+    if (!locations.empty()) {
+        loading_ = true;
+        locations_pending_ = static_cast<int>(locations.size());
+        loading_keys_.clear();
+        for (size_t i = 0; i < locations.size(); ++i) {
+            StoredLocation &location = locations[i];
+            loading_keys_.push_back(location.key);
+            QByteArray fingerprint = QByteArray::fromStdString(location.fingerprint);
+            stored_fingerprints_[location.key] = fingerprint;
+            if (!fingerprint.isEmpty())
+                fingerprints_[location.key] = fingerprint;
+            // Items keep referring to slices of this instead of a copy of their text each.  "[...]"
+            QByteArray items = QByteArray::fromStdString(location.items);
+            parser_.ParseStored(static_cast<int>(i), items, 1, std::max(1, items.size() - 1));
+        }
+        return;
+    }
+
+    // Stored as a single array by an older version, moved to the locations table once loaded
+    QByteArray stored_items = QByteArray::fromStdString(data_.Get("items"));
+    load_legacy_ = !stored_items.isEmpty();
+    ParseFingerprints(data_.Get("fingerprints"));
+    if (load_legacy_ && !StashReplyReader(stored_items, ItemLocation()).ReadStored(&items_))
+        load_failed_ = true;
+    FinishLoad();
+}
+
+void ItemsManagerWorker::OnStoredParsed(std::shared_ptr<ParsedReply> result) {
+    if (!result->valid) {
+        // Only this location is lost, the next update writes it again since it has no stored fingerprint
+        const std::string &key = loading_keys_[result->request_id];
+        QLOG_WARN() << "Malformed items data of" << key.c_str() << ", it will be fetched again";
+        fingerprints_.erase(key);
+        stored_fingerprints_[key].clear();
+        load_incomplete_ = true;
+    } else if (!result->items.empty()) {
+        items_.insert(items_.end(), result->items.begin(), result->items.end());
+        emit LocationRefreshed(TabLocation(result->items.front()->location()), result->items);
+    }
+    if (--locations_pending_ == 0)
+        FinishLoad();
+}
+
+void ItemsManagerWorker::FinishLoad() {
+    loading_ = false;
+    loading_keys_.clear();
+    // Only the single array of older versions fails as a whole, see OnStoredParsed for locations
+    if (load_failed_) {
+        QLOG_ERROR() << "Malformed items data, starting with an empty stash";
+        items_.clear();
+        fingerprints_.clear();
+        load_incomplete_ = true;
+    }
+    SortItems(&items_);
+    QLOG_INFO() << "Loading" << items_.size() << "items took" << load_timer_.elapsed() << "ms";
+    if (AllocationStats::Enabled()) {
+        AllocationStats allocations = AllocationStats::Current() - load_allocations_;
+        QLOG_INFO() << "Loading" << items_.size() << "items made" << allocations.count << "allocations of"
+                    << allocations.bytes << "bytes";
+    }
+    std::map<ItemLocation, Items> locations;
+    for (auto &item : items_)
+        locations[TabLocation(item->location())].push_back(item);
+    SeedParser(locations);
+    emit ItemsRefreshed(items_, tabs_, true, !load_incomplete_);
+
+    if (load_legacy_ && !load_failed_ && StoreLocations(locations)) {
+        data_.Set("items", "");
+        data_.Set("fingerprints", "");
+    }
+    load_legacy_ = false;
+
+    if (update_after_load_) {
+        update_after_load_ = false;
+        Update(deferred_selection_, deferred_locations_);
+    }
+}
+
+void ItemsManagerWorker::SeedParser(const std::map<ItemLocation, Items> &locations) {
+    for (auto &location : locations) {
+        auto it = fingerprints_.find(location.first.GetHeader());
+        if (it != fingerprints_.end())
+            parser_.Seed(location.first, it->second, location.second);
+    }
+}
+
+void ItemsManagerWorker::ParseFingerprints(const std::string &fingerprints) {
+    rapidjson::Document doc;
+    if (fingerprints.empty() || doc.Parse(fingerprints.c_str()).HasParseError() || !doc.IsObject())
+        return;
+    for (auto it = doc.MemberBegin(); it != doc.MemberEnd(); ++it)
+        if (it->value.IsString())
+            fingerprints_[it->name.GetString()] = QByteArray::fromHex(it->value.GetString());
+}
+
+bool ItemsManagerWorker::StoreLocations(const std::map<ItemLocation, Items> &locations) {
+    // Same fingerprint means the same reply, so the same items.  Locations without one are
+    // always written, e.g. the tab that came with the tab list.
+    std::vector<StoredLocation> changed;
+    std::set<std::string> present;
+    for (auto &location : locations) {
+        std::string key = location.first.GetHeader();
+        present.insert(key);
+        auto fingerprint = fingerprints_.find(key);
+        auto stored = stored_fingerprints_.find(key);
+        if (fingerprint != fingerprints_.end() && stored != stored_fingerprints_.end() && stored->second == fingerprint->second)
+            continue;
+
+        StoredLocation row;
+        row.key = key;
+        if (fingerprint != fingerprints_.end())
+            row.fingerprint = fingerprint->second.toStdString();
+        // Streamed together from the slices of replies items refer to, sized up front
+        size_t size = 2;
+        for (auto const &item : location.second)
+            size += item->json().size() + 1;
+        row.items.reserve(size);
+        row.items += '[';
+        for (auto const &item : location.second) {
+            if (row.items.size() > 1)
+                row.items += ',';
+            item->json().AppendTo(&row.items);
+        }
+        row.items += ']';
+        changed.push_back(std::move(row));
+    }
+    std::vector<std::string> removed;
+    for (auto &stored : stored_fingerprints_)
+        if (!present.count(stored.first))
+            removed.push_back(stored.first);
+    if (changed.empty() && removed.empty())
+        return true;
+
+    if (!data_.SetLocations(changed, removed)) {
+        QLOG_ERROR() << "Failed to store items of" << changed.size() << "locations";
+        return false;
+    }
+    for (auto &key : removed)
+        stored_fingerprints_.erase(key);
+    for (auto &row : changed)
+        stored_fingerprints_[row.key] = QByteArray::fromStdString(row.fingerprint);
+    QLOG_DEBUG() << "Stored items of" << changed.size() << "locations, removed" << removed.size();
+    return true;
+}
+
+ItemLocation ItemsManagerWorker::TabLocation(const ItemLocation &location) {
+    // Item locations carry their position too, keep the tab or character only
+    if (location.get_type() == ItemLocationType::STASH)
+        return ItemLocation(location.get_tab_id(), location.get_tab_label());
+    ItemLocation character;
+    character.set_type(ItemLocationType::CHARACTER);
+    character.set_character(location.get_character());
+    return character;
 }
 
 void ItemsManagerWorker::Update(TabSelection::Type type, const std::vector<ItemLocation> &locations) {
+    if (loading_) {
+        // Needs to know what was stored first, the last request wins
+        QLOG_DEBUG() << "Update requested while loading items, starting it afterwards";
+        update_after_load_ = true;
+        deferred_selection_ = type;
+        deferred_locations_ = locations;
+        return;
+    }
     if (updating_) {
+        if (type == TabSelection::Selected) {
+            Reprioritize(locations);
+            return;
+        }
         QLOG_WARN() << "ItemsManagerWorker::Update called while updating";
         return;
     }
@@ -122,22 +338,43 @@ void ItemsManagerWorker::Update(TabSelection::Type type, const std::vector<ItemL
 
     QLOG_DEBUG() <<  "Updating" << tab_selection_ << "stash tabs";
     updating_ = true;
+    update_timer_.start();
+    update_skipped_msecs_ = rate_limiter_->skipped_msecs();
+    update_allocations_ = AllocationStats::Current();
+    tab_cache_->StartRefresh();
+
+    // Whatever is displayed stays there until its location is received again
+    std::set<ItemLocation> shown(tabs_.begin(), tabs_.end());
+    for (auto &item : items_)
+        shown.insert(item->location());
+    emit LocationsStale(std::vector<ItemLocation>(shown.begin(), shown.end()));
 
     cancel_update_ = false;
     // remove all mappings (from previous requests)
     if (signal_mapper_)
         delete signal_mapper_;
     signal_mapper_ = new QSignalMapper;
+    connect(signal_mapper_, SIGNAL(mapped(int)), this, SLOT(OnTabReceived(int)));
     // remove all pending requests
-    queue_ = std::queue<ItemsRequest>();
+    queue_.clear();
+    character_queue_.clear();
     queue_id_ = 0;
+    total_completed_ = total_needed_ = total_cached_ = 0;
+    tab_list_received_ = false;
+    tab_list_verified_ = false;
+    first_tab_request_ = -1;
+    resyncs_ = 0;
+    tab_list_failures_ = 0;
+    ++epoch_;
     replies_.clear();
     items_.clear();
+    location_items_.clear();
     tabs_as_string_ = "";
     selected_character_ = "";
+    last_character_fetched_ = "";
 
     // first, download the main page because it's the only way to know which character is selected
-    QNetworkReply *main_page = network_manager_.get(Request(QUrl(kMainPage), ItemLocation(), TabCache::Refresh));
+    QNetworkReply *main_page = network_manager_.get(Request(ApiUrl(kMainPagePath), ItemLocation(), TabCache::Refresh));
     connect(main_page, &QNetworkReply::finished, this, &ItemsManagerWorker::OnMainPageReceived);
 }
 
@@ -156,7 +393,7 @@ void ItemsManagerWorker::OnMainPageReceived() {
     }
 
     // now get character list
-    QNetworkReply *characters = network_manager_.get(Request(QUrl(kGetCharactersUrl), ItemLocation(), TabCache::Refresh));
+    QNetworkReply *characters = network_manager_.get(Request(ApiUrl(kGetCharactersPath), ItemLocation(), TabCache::Refresh));
     connect(characters, &QNetworkReply::finished, this, &ItemsManagerWorker::OnCharacterListReceived);
 
     reply->deleteLater();
@@ -211,6 +448,9 @@ void ItemsManagerWorker::OnCharacterListReceived() {
         updating_ = false;
         return;
     }
+    total_needed_ += char_count;
+    // Characters don't depend on the tab list, get them while the first tab is on its way
+    FetchCharacters();
 
     // Fetch a single tab and also request tabs list.  We can fetch any tab here with tabs list
     // appended, so prefer one that the user has already 'checked'.  Default to index '1' which is
@@ -234,9 +474,18 @@ void ItemsManagerWorker::OnCharacterListReceived() {
         }
     }
 
+    FetchFirstTab();
+    reply->deleteLater();
+}
+
+void ItemsManagerWorker::FetchFirstTab() {
+    // The first tab counts against the same limit as the rest of them
+    if (!rate_limiter_->TryAcquire()) {
+        QTimer::singleShot(rate_limiter_->MsecsUntilNextRequest(), this, SLOT(FetchFirstTab()));
+        return;
+    }
     QNetworkReply *first_tab = network_manager_.get(MakeTabRequest(first_fetch_tab_, ItemLocation(), true, true));
     connect(first_tab, SIGNAL(finished()), this, SLOT(OnFirstTabReceived()));
-    reply->deleteLater();
 }
 
 QNetworkRequest ItemsManagerWorker::MakeTabRequest(int tab_index, const ItemLocation &location, bool tabs, bool refresh) {
@@ -246,7 +495,7 @@ QNetworkRequest ItemsManagerWorker::MakeTabRequest(int tab_index, const ItemLoca
     query.addQueryItem("tabIndex", QString::number(tab_index));
     query.addQueryItem("accountName", account_name_.c_str());
 
-    QUrl url(kStashItemsUrl);
+    QUrl url(ApiUrl(kStashItemsPath));
     url.setQuery(query);
 
     // If refresh is explicity request then force unconditionally
@@ -260,13 +509,16 @@ QNetworkRequest ItemsManagerWorker::MakeCharacterRequest(const std::string &name
     query.addQueryItem("character", name.c_str());
     query.addQueryItem("accountName", account_name_.c_str());
 
-    QUrl url(kCharacterItemsUrl);
+    QUrl url(ApiUrl(kCharacterItemsPath));
     url.setQuery(query);
 
     return Request(url, location, TabCache::None);
 }
 
 QNetworkRequest ItemsManagerWorker::Request(QUrl url, const ItemLocation &location, TabCache::Flags flags) {
+    // Tabs picked by the user are refreshed no matter how the update was started
+    if (location.IsValid() && selected_tabs_.count(location.GetHeader()))
+        flags |= TabCache::Refresh;
     switch (tab_selection_) {
     case TabSelection::All:
         flags |= TabCache::Refresh;
@@ -289,117 +541,323 @@ void ItemsManagerWorker::QueueRequest(const QNetworkRequest &request, const Item
     items_request.network_request = request;
     items_request.id = queue_id_++;
     items_request.location = location;
-    queue_.push(items_request);
+    items_request.epoch = epoch_;
+    if (location.get_type() == ItemLocationType::CHARACTER)
+        character_queue_.push_back(items_request);
+    else
+        queue_.push_back(items_request);
 }
 
-void ItemsManagerWorker::FetchItems(int limit) {
-    std::string tab_titles;
-    int count = std::min(limit, static_cast<int>(queue_.size()));
-    for (int i = 0; i < count; ++i) {
-        ItemsRequest request = queue_.front();
-        queue_.pop();
+int ItemsManagerWorker::RequestPriority(const ItemsRequest &request) const {
+    auto &location = request.location;
+    if (selected_tabs_.count(location.GetHeader()))
+        return kPrioritySelected;
+    if (location.get_type() == ItemLocationType::CHARACTER)
+        return location.get_character() == selected_character_ ? kPriorityActiveCharacter : kPriorityRefresh;
+    if (bo_manager_.GetRefreshLocked(location) || bo_manager_.GetRefreshChecked(location))
+        return kPriorityRefresh;
+    return kPriorityStale;
+}
 
-        QNetworkReply *fetched = network_manager_.get(request.network_request);
-        signal_mapper_->setMapping(fetched, request.id);
-        connect(fetched, SIGNAL(finished()), signal_mapper_, SLOT(map()));
+RateLimiter &ItemsManagerWorker::Limiter(const ItemLocation &location) {
+    return location.get_type() == ItemLocationType::CHARACTER ? *character_limiter_ : *rate_limiter_;
+}
+
+std::vector<ItemsRequest>::iterator ItemsManagerWorker::NextRequest(std::vector<ItemsRequest> *queue) {
+    // Priorities can change at any time (user selection, pricing) so just scan,
+    // the queue is never longer than the number of tabs and characters
+    auto key = [this](const ItemsRequest &request) {
+        auto it = last_fetched_.find(request.location.GetHeader());
+        qint64 fetched = (it == last_fetched_.end()) ? 0 : it->second;
+        return std::make_tuple(RequestPriority(request), fetched, request.id);
+    };
+    return std::min_element(queue->begin(), queue->end(), [&key](const ItemsRequest &lhs, const ItemsRequest &rhs) {
+        return key(lhs) < key(rhs);
+    });
+}
+
+void ItemsManagerWorker::Reprioritize(const std::vector<ItemLocation> &locations) {
+    for (auto const &location : locations) {
+        if (!location.IsValid())
+            continue;
+        std::string header = location.GetHeader();
+        selected_tabs_.insert(header);
+        QLOG_DEBUG() << "Moving" << header.c_str() << "to the front of the update";
+
+        // Until the tab list is in, stash tabs aren't queued yet and will pick up the selection
+        if (!tab_list_received_ && location.get_type() == ItemLocationType::STASH)
+            continue;
+
+        bool pending = false;
+        auto &queue = (location.get_type() == ItemLocationType::STASH) ? queue_ : character_queue_;
+        for (auto &request : queue) {
+            if (request.location.GetHeader() == header) {
+                // The request could have been made to allow a cached reply, make a refreshing one
+                request.network_request = (location.get_type() == ItemLocationType::STASH)
+                    ? MakeTabRequest(request.location.get_tab_id(), request.location)
+                    : MakeCharacterRequest(request.location.get_character(), request.location);
+                pending = true;
+            }
+        }
+        for (auto &reply : replies_)
+            if (reply.second.request.location.GetHeader() == header)
+                pending = true;
+
+        if (!pending) {
+            // Already received during this update, get it again
+            if (location.get_type() == ItemLocationType::STASH) {
+                auto tab = std::find_if(tabs_.begin(), tabs_.end(), [&header](const ItemLocation &tab) {
+                    return tab.GetHeader() == header;
+                });
+                if (tab == tabs_.end())
+                    continue;
+                QueueRequest(MakeTabRequest(tab->get_tab_id(), *tab), *tab);
+            } else {
+                ItemLocation character;
+                character.set_type(ItemLocationType::CHARACTER);
+                character.set_character(location.get_character());
+                QueueRequest(MakeCharacterRequest(location.get_character(), character), character);
+            }
+            ++total_needed_;
+        }
+    }
+    FetchItems();
+}
+
+void ItemsManagerWorker::FetchItems() {
+    fetch_scheduled_ = false;
+    FetchCharacters();
+    if (cancel_update_ || !tab_list_received_)
+        return;
 
-        ItemsReply reply;
-        reply.network_reply = fetched;
-        reply.request = request;
-        replies_[request.id] = reply;
+    std::string tab_titles;
+    int count = 0;
+    while (!queue_.empty()) {
+        auto next = NextRequest(&queue_);
+        ItemsRequest request = *next;
+        // Requests that are going to be served from the tab cache never reach the server
+        // so they don't count against the rate limit.
+        bool cached = tab_cache_->Serves(request.network_request);
+        // Don't pile up more replies than the parser can keep up with
+        if (parser_.Full() || (!cached && !rate_limiter_->TryAcquire()))
+            break;
+        queue_.erase(next);
+        Send(request);
 
         tab_titles += request.location.GetHeader() + " ";
+        ++count;
+    }
+    if (count > 0)
+        QLOG_DEBUG() << "Created" << count << "requests:" << tab_titles.c_str();
+    // Parser being busy reschedules us from OnTabParsed
+    if (!queue_.empty() && !parser_.Full())
+        ScheduleFetch();
+}
+
+void ItemsManagerWorker::FetchCharacters() {
+    character_fetch_scheduled_ = false;
+    if (cancel_update_)
+        return;
+
+    while (!character_queue_.empty()) {
+        auto next = NextRequest(&character_queue_);
+        ItemsRequest request = *next;
+        bool cached = tab_cache_->Serves(request.network_request);
+        if (parser_.Full() || (!cached && !character_limiter_->TryAcquire()))
+            break;
+        character_queue_.erase(next);
+        Send(request);
+        // Only what reaches the server changes the character selected in game
+        if (!cached)
+            last_character_fetched_ = request.location.get_character();
+        QLOG_DEBUG() << "Created request:" << request.location.GetHeader().c_str();
+    }
+    if (!character_queue_.empty() && !parser_.Full() && !character_fetch_scheduled_) {
+        character_fetch_scheduled_ = true;
+        QTimer::singleShot(std::max(character_limiter_->MsecsUntilNextRequest(), 1), this, SLOT(FetchCharacters()));
     }
-    QLOG_DEBUG() << "Created" << count << "requests:" << tab_titles.c_str();
-    requests_needed_ = count;
-    requests_completed_ = 0;
-    cached_requests_completed_ = 0;
+}
+
+void ItemsManagerWorker::Send(const ItemsRequest &request) {
+    QNetworkReply *fetched = network_manager_.get(request.network_request);
+    signal_mapper_->setMapping(fetched, request.id);
+    connect(fetched, SIGNAL(finished()), signal_mapper_, SLOT(map()));
+
+    ItemsReply reply;
+    reply.network_reply = fetched;
+    reply.request = request;
+    replies_[request.id] = reply;
+}
+
+void ItemsManagerWorker::ScheduleFetch() {
+    if (fetch_scheduled_)
+        return;
+    fetch_scheduled_ = true;
+    QTimer::singleShot(std::max(rate_limiter_->MsecsUntilNextRequest(), 1), this, SLOT(FetchItems()));
 }
 
 void ItemsManagerWorker::OnFirstTabReceived() {
     QNetworkReply *reply = qobject_cast<QNetworkReply *>(QObject::sender());
-    QByteArray bytes = reply->readAll();
-    rapidjson::Document doc;
-    doc.Parse(bytes.constData());
+    if (reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool())
+        ++total_cached_;
+    rate_limiter_->Update(reply);
 
-    if (!doc.IsObject()) {
+    // Tab list and items are both taken apart on the parser pool, see OnFirstTabParsed
+    first_tab_request_ = queue_id_++;
+    parser_.ParseFirstTab(first_tab_request_, reply->readAll(), first_fetch_tab_);
+    reply->deleteLater();
+}
+
+void ItemsManagerWorker::OnFirstTabParsed(const ParsedReply &result) {
+    first_tab_request_ = -1;
+
+    if (!result.valid) {
         QLOG_ERROR() << "Can't even fetch first tab. Failed to update items.";
         updating_ = false;
         return;
     }
 
-    if (doc.HasMember("error")) {
-        QLOG_ERROR() << "Aborting update since first fetch failed due to 'error': " << Util::RapidjsonSerialize(doc["error"]).c_str();
+    if (!result.error.empty()) {
+        QLOG_ERROR() << "Aborting update since first fetch failed due to 'error': " << result.error.c_str();
         updating_ = false;
         return;
     }
 
-    if (!doc.HasMember("tabs") || doc["tabs"].Size() == 0) {
+    rapidjson::Document doc;
+    doc.Parse(result.tabs.c_str());
+    if (!result.has_tabs || !doc.IsArray() || doc.Size() == 0) {
         QLOG_WARN() << "There are no tabs, this should not happen, bailing out.";
         updating_ = false;
         return;
     }
 
-    tabs_as_string_ = Util::RapidjsonSerialize(doc["tabs"]);
-    tabs_signature_ = CreateTabsSignatureVector(tabs_as_string_);
-
-    QLOG_DEBUG() << "Received tabs list, there are" << doc["tabs"].Size() << "tabs";
+    QLOG_DEBUG() << "Received tabs list, there are" << doc.Size() << "tabs";
 
     std::set<std::string> old_tab_headers;
     for (auto const &tab: tabs_) {
-        // Remember old tab headers before clearing tabs
+        // Remember old tab headers before replacing tabs
         old_tab_headers.insert(tab.GetHeader());
     }
-    tabs_.clear();
+    TabHashes old_hashes = tab_hashes_;
+    SetTabs(doc);
 
-    // Create tab location objects
-    for (auto &tab : doc["tabs"]) {
-        std::string label = tab["n"].GetString();
-        auto index = tab["i"].GetInt();
-        // Ignore hidden locations
-        if (!doc["tabs"][index].HasMember("hidden") || !doc["tabs"][index]["hidden"].GetBool())
-            tabs_.push_back(ItemLocation(index, label, ItemLocationType::STASH));
-    }
-
-    // Immediately parse items received from this tab (first_fetch_tab_) and Queue requests for the others
+    // Take the items parsed from this tab (first_fetch_tab_) and Queue requests for the others
     for (auto const &tab: tabs_) {
         bool refresh = false;
 
         auto index = tab.get_tab_id();
         if (index == first_fetch_tab_) {
-            ParseItems(&doc["items"], tab, doc.GetAllocator());
+            location_items_[tab] = result.items;
+            emit LocationRefreshed(tab, location_items_[tab]);
         } else {
             // Force refreshes for any tabs that were moved or renamed regardless of what user
-            // requests for refresh.
-            if (!old_tab_headers.count(tab.GetHeader())) {
+            // requests for refresh.  Cached replies don't carry the tab list to catch that later.
+            size_t position = index;
+            if (!old_tab_headers.count(tab.GetHeader()) || position >= old_hashes.size()
+                    || old_hashes[position] != tab_hashes_[position]) {
                 QLOG_DEBUG() << "Forcing refresh of moved or renamed tab: " << tab.GetHeader().c_str();
                 refresh = true;
             }
-            QueueRequest(MakeTabRequest(index, tab, true, refresh), tab);
+            bool sample = queue_.size() % kTabListSampleInterval == kTabListSampleInterval - 1;
+            QueueRequest(MakeTabRequest(index, tab, sample, refresh), tab);
         }
     }
 
-    total_needed_ = queue_.size() + 1;
-    total_completed_ = 1;
-    total_cached_ = reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool() ? 1:0;
+    tab_list_received_ = true;
+    // Characters may be done already, they were counted along with the character list
+    total_needed_ += queue_.size() + 1;
+    ++total_completed_;
 
-    FetchItems(kThrottleRequests - 1);
+    FetchItems();
+    CheckCompletion();
+}
 
-    connect(signal_mapper_, SIGNAL(mapped(int)), this, SLOT(OnTabReceived(int)));
-    reply->deleteLater();
+void ItemsManagerWorker::SetTabs(const rapidjson::Value &tabs) {
+    tabs_as_string_ = Util::RapidjsonSerialize(tabs);
+    tabs_signature_ = TabParser::CreateTabsSignature(tabs);
+    tab_hashes_ = TabParser::CreateTabHashes(tabs);
+    tabs_.clear();
+
+    // Create tab location objects
+    for (auto &tab : tabs) {
+        std::string label = tab["n"].GetString();
+        auto index = tab["i"].GetInt();
+        // Ignore hidden locations
+        if (!tabs[index].HasMember("hidden") || !tabs[index]["hidden"].GetBool())
+            tabs_.push_back(ItemLocation(index, label, ItemLocationType::STASH));
+    }
+}
+
+bool ItemsManagerWorker::HasTabList(const QNetworkRequest &request) {
+    return QUrlQuery(request.url()).queryItemValue("tabs") == "1";
 }
 
-void ItemsManagerWorker::ParseItems(rapidjson::Value *value_ptr, const ItemLocation &base_location, rapidjson_allocator &alloc) {
-    auto &value = *value_ptr;
-    for (auto &item : value) {
-        ItemLocation location(base_location);
-        location.FromItemJson(item);
-        location.ToItemJson(&item, alloc);
-        items_.push_back(std::make_shared<Item>(item));
-        location.set_socketed(true);
-        if (item.HasMember("socketedItems") && item["socketedItems"].IsArray())
-            ParseItems(&item["socketedItems"], location, alloc);
+bool ItemsManagerWorker::IsStale(const ItemsRequest &request) const {
+    return request.location.get_type() == ItemLocationType::STASH && request.epoch != epoch_;
+}
+
+bool ItemsManagerWorker::Resync(const ParsedReply &result) {
+    rapidjson::Document doc;
+    doc.Parse(result.tabs.c_str());
+    if (!doc.IsArray() || doc.Size() == 0)
+        return false;
+
+    ++resyncs_;
+    ++epoch_;
+    TabHashes old_hashes = tab_hashes_;
+    SetTabs(doc);
+    auto unchanged = [this, &old_hashes](const ItemLocation &location) {
+        size_t index = location.get_tab_id();
+        return index < old_hashes.size() && index < tab_hashes_.size() && old_hashes[index] == tab_hashes_[index];
+    };
+
+    // Locations that are done, queued or in flight for the new tab list
+    std::set<int> covered;
+    for (auto it = location_items_.begin(); it != location_items_.end();) {
+        auto &location = it->first;
+        if (location.get_type() != ItemLocationType::STASH) {
+            ++it;
+        } else if (unchanged(location)) {
+            covered.insert(location.get_tab_id());
+            ++it;
+        } else {
+            parser_.Forget(location);
+            it = location_items_.erase(it);
+            --total_completed_;
+        }
+    }
+    queue_.erase(std::remove_if(queue_.begin(), queue_.end(), [&unchanged](const ItemsRequest &request) {
+        return request.location.get_type() == ItemLocationType::STASH && !unchanged(request.location);
+    }), queue_.end());
+    for (auto &request : queue_) {
+        request.epoch = epoch_;
+        if (request.location.get_type() == ItemLocationType::STASH)
+            covered.insert(request.location.get_tab_id());
+    }
+    // Replies for tabs that stayed where they were are still good, everything else is dropped when it arrives
+    int in_flight = 0;
+    for (auto &reply : replies_) {
+        auto &request = reply.second.request;
+        if (request.location.get_type() != ItemLocationType::STASH) {
+            ++in_flight;
+        } else if (unchanged(request.location)) {
+            request.epoch = epoch_;
+            covered.insert(request.location.get_tab_id());
+            ++in_flight;
+        }
+    }
+
+    int requeued = 0;
+    for (auto const &tab : tabs_) {
+        if (covered.count(tab.get_tab_id()))
+            continue;
+        // Moved tabs may have a cached reply for their old index, always refresh
+        QueueRequest(MakeTabRequest(tab.get_tab_id(), tab, false, true), tab);
+        ++requeued;
     }
+    total_needed_ = total_completed_ + queue_.size() + character_queue_.size() + in_flight;
+    QLOG_INFO() << "Tabs changed during the update, fetching" << requeued << "of" << tabs_.size() << "tabs again";
+    return true;
 }
 
 void ItemsManagerWorker::OnTabReceived(int request_id) {
@@ -408,29 +866,78 @@ void ItemsManagerWorker::OnTabReceived(int request_id) {
         return;
     }
 
-    ItemsReply reply = replies_[request_id];
+    ItemsReply &reply = replies_[request_id];
+    QNetworkReply *network_reply = reply.network_reply;
+    reply.network_reply = nullptr;
 
-    bool reply_from_cache = reply.network_reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
+    if (IsStale(reply.request)) {
+        QLOG_DEBUG() << "Dropping reply for" << reply.request.location.GetHeader().c_str() << "made for an old tab list";
+        if (!network_reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool())
+            rate_limiter_->Update(network_reply);
+        replies_.erase(request_id);
+        if (cancel_update_ && replies_.empty())
+            updating_ = false;
+        network_reply->deleteLater();
+        return;
+    }
+    reply.from_cache = network_reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
 
-    if (reply_from_cache) {
+    if (reply.from_cache) {
         QLOG_DEBUG() << "Received a cached reply for" << reply.request.location.GetHeader().c_str();
-        ++cached_requests_completed_;
         ++total_cached_;
     } else {
         QLOG_DEBUG() << "Received a reply for" << reply.request.location.GetHeader().c_str();
+        Limiter(reply.request.location).Update(network_reply);
     }
 
-    QByteArray bytes = reply.network_reply->readAll();
-    rapidjson::Document doc;
-    doc.Parse(bytes.constData());
+    if (network_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 429) {
+        // Rate limiter of its lane already knows how long to back off for, just try again later
+        QLOG_WARN() << request_id << "was rate limited by the server, retrying in"
+                    << Limiter(reply.request.location).MsecsUntilNextRequest() << "ms";
+        tab_cache_->remove(reply.request.network_request.url());
+        QueueRequest(reply.request.network_request, reply.request.location);
+        replies_.erase(request_id);
+        if (cancel_update_ && replies_.empty())
+            updating_ = false;
+        else if (!cancel_update_)
+            FetchItems();
+        EmitStatus(Paused());
+    } else {
+        parser_.Parse(request_id, network_reply->readAll(), reply.request.location);
+    }
+
+    network_reply->deleteLater();
+}
+
+void ItemsManagerWorker::OnTabParsed(std::shared_ptr<ParsedReply> result) {
+    int request_id = result->request_id;
+    if (request_id == first_tab_request_) {
+        OnFirstTabParsed(*result);
+        return;
+    }
+    if (!replies_.count(request_id)) {
+        // Belongs to an update that is over already
+        return;
+    }
+
+    ItemsReply reply = replies_[request_id];
+    replies_.erase(request_id);
+    bool reply_from_cache = reply.from_cache;
+
+    if (IsStale(reply.request)) {
+        // Tab list changed while this one was being parsed
+        if (cancel_update_ && replies_.empty())
+            updating_ = false;
+        return;
+    }
 
     bool error = false;
-    if (!doc.IsObject()) {
+    if (!result->valid) {
         QLOG_WARN() << request_id << "got a non-object response";
         error = true;
-    } else if (doc.HasMember("error")) {
+    } else if (!result->error.empty()) {
         // this can happen if user is browsing stash in background and we can't know about it
-        QLOG_WARN() << request_id << "got 'error' instead of stash tab contents: " << Util::RapidjsonSerialize(doc["error"]).c_str();
+        QLOG_WARN() << request_id << "got 'error' instead of stash tab contents: " << result->error.c_str();
         error = true;
     }
 
@@ -438,16 +945,21 @@ void ItemsManagerWorker::OnTabReceived(int request_id) {
     // to move or rename tabs during the update which will result in the item data being out-of-sync with
     // expected index/tab name map.  We need to detect this case and abort the update.
     if (!cancel_update_ && !error && (reply.request.location.get_type() == ItemLocationType::STASH)) {
-        if (!doc.HasMember("tabs") || doc["tabs"].Size() == 0) {
+        if (!HasTabList(reply.request.network_request)) {
+            // Nothing to check, VerifyTabList takes care of it at the end
+        } else if (!result->has_tabs) {
             QLOG_ERROR() << "Full tab information missing from stash tab fetch.  Cancelling update. Full fetch URL: "
                          << reply.request.network_request.url().toDisplayString();
             cancel_update_ = true;
         } else {
-            std::string tabs_as_string = Util::RapidjsonSerialize(doc["tabs"]);
-            auto tabs_signature_current = CreateTabsSignatureVector(tabs_as_string);
-
-            auto tab_id = reply.request.location.get_tab_id();
-            if (tabs_signature_[tab_id] != tabs_signature_current[tab_id]) {
+            auto &tab_hashes_current = result->tab_hashes;
+
+            size_t tab_id = reply.request.location.get_tab_id();
+            bool mismatch = tab_id >= tab_hashes_current.size() || tab_id >= tab_hashes_.size()
+                || tab_hashes_[tab_id] != tab_hashes_current[tab_id]
+                // Few replies carry the tab list now, use them to notice changes to any tab
+                || tab_hashes_current != tab_hashes_;
+            if (mismatch) {
                 if (reply_from_cache) {
                     // Here we unexpectedly are seeing a cached document that is out-of-sync with current tab state
                     // This is not fatal but unexpected as we shouldn't get here if everything else is done right.
@@ -458,19 +970,33 @@ void ItemsManagerWorker::OnTabReceived(int request_id) {
                     // Isn't really cached since we're erroring out and replaying so fix up stats
                     total_cached_--;
                 } else {
+                    // Only now that something is off the whole tab list is worth looking at
+                    TabsSignature tabs_signature_current = CreateTabsSignatureVector(result->tabs);
                     std::string reason;
                     if (tabs_signature_current.size() != tabs_signature_.size())
                         reason += "[Tab size mismatch:" + std::to_string(tabs_signature_current.size()) + " != "
                                 + std::to_string(tabs_signature_.size()) + "]";
 
-                    auto &x = tabs_signature_current[tab_id];
-                    auto &y = tabs_signature_[tab_id];
                     reason += "[tab_index=" + std::to_string(tab_id) + "/" + std::to_string(tabs_signature_current.size()) + "(#" + std::to_string(tab_id+1) + ")]";
-                    if (x.first != y.first)
-                        reason += "[name:" + x.first + " != " + y.first + "]";
-                    if (x.second != y.second)
-                        reason += "[id:" + x.second + " != " + y.second + "]";
-
+                    if (tab_id < tabs_signature_current.size() && tab_id < tabs_signature_.size()) {
+                        auto &x = tabs_signature_current[tab_id];
+                        auto &y = tabs_signature_[tab_id];
+                        if (x.first != y.first)
+                            reason += "[name:" + x.first + " != " + y.first + "]";
+                        if (x.second != y.second)
+                            reason += "[id:" + x.second + " != " + y.second + "]";
+                    }
+
+                    // Items of this reply belong to whatever tab is at its index now, Resync fetches it again
+                    if (resyncs_ < kMaxTabResyncs && Resync(*result)) {
+                        QLOG_WARN() << "You renamed or re-ordered tabs in game while acquisition was in the middle of the update,"
+                                    << " continuing with the new tab list. Mismatch reason(s) -> " << reason.c_str()
+                                    << ". For request: " << reply.request.network_request.url().toDisplayString();
+                        FetchItems();
+                        EmitStatus(Paused());
+                        CheckCompletion();
+                        return;
+                    }
                     QLOG_ERROR() << "You renamed or re-ordered tabs in game while acquisition was in the middle of the update,"
                                  << " aborting to prevent synchronization problems and pricing data loss. Mismatch reason(s) -> "
                                  << reason.c_str() << ". For request: " << reply.request.network_request.url().toDisplayString();
@@ -485,107 +1011,222 @@ void ItemsManagerWorker::OnTabReceived(int request_id) {
         // We can 'cache' error response document so make sure we remove it
         // before reque
         tab_cache_->remove(reply.request.network_request.url());
+        parser_.Forget(reply.request.location);
         QueueRequest(reply.request.network_request, reply.request.location);
+    } else if (!cancel_update_ && !result->reused) {
+        parser_.Remember(result);
     }
 
-    ++requests_completed_;
-
     if (!error)
         ++total_completed_;
 
-    bool throttled = false;
-
-    if (requests_completed_ == requests_needed_) {
-        if (cancel_update_) {
+    if (cancel_update_) {
+        // Wait for the requests that are already in flight before allowing another update
+        if (replies_.empty())
             updating_ = false;
-        } else if (queue_.size() > 0) {
-            if (cached_requests_completed_ > 0) {
-                // We basically don't want cached requests to count against throttle limit
-                // so if we did get any cached requests fetch up to that number without a
-                // large delay
-                QTimer::singleShot(1, [&]() { FetchItems(cached_requests_completed_); });
-            } else {
-                throttled = true;
-                QLOG_DEBUG() << "Sleeping one minute to prevent throttling.";
-                QTimer::singleShot(kThrottleSleep * 1000, this, SLOT(FetchItems()));
-            }
-        }
+    } else if (!queue_.empty() || !character_queue_.empty()) {
+        FetchItems();
     }
-    CurrentStatusUpdate status = CurrentStatusUpdate();
-    status.state = throttled ? ProgramState::ItemsPaused : ProgramState::ItemsReceive;
-    status.progress = total_completed_;
-    status.total = total_needed_;
-    status.cached = total_cached_;
-    if (total_completed_ == total_needed_)
-        status.state = ProgramState::ItemsCompleted;
-    if (cancel_update_)
-        status.state = ProgramState::UpdateCancelled;
-    emit StatusUpdate(status);
 
-    if (error)
+    EmitStatus(Paused());
+
+    if (error || cancel_update_)
         return;
 
-    ParseItems(&doc["items"], reply.request.location, doc.GetAllocator());
+    std::string header = reply.request.location.GetHeader();
+    last_fetched_[header] = QDateTime::currentMSecsSinceEpoch();
+    // Replies carrying the tab list can't be seeded next time, the parser wouldn't know the list
+    if (result->has_tabs)
+        fingerprints_.erase(header);
+    else
+        fingerprints_[header] = result->fingerprint;
+
+    // A location can be received more than once if it was moved to the front of the update
+    auto &items = location_items_[reply.request.location];
+    items = result->items;
+    // Reused items are the very same objects the UI got last time
+    if (result->reused)
+        emit LocationRevalidated(reply.request.location);
+    else
+        emit LocationRefreshed(reply.request.location, items);
+
+    CheckCompletion();
+}
+
+void ItemsManagerWorker::CheckCompletion() {
+    if (!updating_ || cancel_update_ || !tab_list_received_ || total_completed_ != total_needed_)
+        return;
+    if (!tab_list_verified_) {
+        VerifyTabList();
+        return;
+    }
+    FinishUpdate();
+}
 
-    if ((total_completed_ == total_needed_) && !cancel_update_) {
-        // It's possible that we receive character vs stash tabs out of order, or users
-        // move items around in a tab and we get them in a different order. For
-        // consistency we want to present the tab data in a deterministic way to the rest
-        // of the application.  Especially so we don't try to update shop when nothing actually
-        // changed.  So sort items_ here before emitting and then generate
-        // item list as strings.
+void ItemsManagerWorker::VerifyTabList() {
+    if (cancel_update_)
+        return;
+    if (!rate_limiter_->TryAcquire()) {
+        QTimer::singleShot(rate_limiter_->MsecsUntilNextRequest(), this, SLOT(VerifyTabList()));
+        return;
+    }
+    int index = tabs_.empty() ? 0 : tabs_.front().get_tab_id();
+    QNetworkReply *reply = network_manager_.get(MakeTabRequest(index, ItemLocation(), true, true));
+    connect(reply, SIGNAL(finished()), this, SLOT(OnTabListVerified()));
+}
 
-        std::sort(begin(items_), end(items_), [](const std::shared_ptr<Item> &a, const std::shared_ptr<Item> &b){
-            return *a < *b;
-        });
+void ItemsManagerWorker::OnTabListVerified() {
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(QObject::sender());
+    QByteArray bytes = reply->readAll();
+    bool throttled = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 429;
+    QString network_error = reply->error() == QNetworkReply::NoError ? QString() : reply->errorString();
+    rate_limiter_->Update(reply);
+    reply->deleteLater();
+    if (!updating_ || cancel_update_)
+        return;
 
-        QStringList tmp;
-        for (auto const &item: items_) {
-            tmp.push_back(item->json().c_str());
+    ParsedReply result;
+    StashReplyReader(bytes, ItemLocation()).Read(&result);
+    if (throttled) {
+        QLOG_WARN() << "Rate limited while fetching the tab list to verify the update, trying again";
+        VerifyTabList();
+        return;
+    }
+    if (!result.has_tabs) {
+        QString reason = !network_error.isEmpty() ? network_error
+            : !result.error.empty() ? QString::fromStdString(result.error) : QString("no tab list in the reply");
+        if (++tab_list_failures_ >= kMaxTabListVerifies) {
+            QLOG_ERROR() << "Couldn't fetch the tab list to verify the update after" << tab_list_failures_
+                         << "attempts, cancelling it. The last error was:" << reason;
+            cancel_update_ = true;
+            if (replies_.empty())
+                updating_ = false;
+            EmitStatus(false);
+            return;
         }
-        auto items_as_string = std::string("[") + tmp.join(",").toStdString() + "]";
+        int delay = kTabListRetryMsecs << (tab_list_failures_ - 1);
+        QLOG_WARN() << "Couldn't fetch the tab list to verify the update:" << reason << "- trying again in" << delay << "ms";
+        QTimer::singleShot(delay, this, SLOT(VerifyTabList()));
+        return;
+    }
 
-        // all requests completed
-        emit ItemsRefreshed(items_, tabs_, false);
+    if (result.tab_hashes == tab_hashes_) {
+        tab_list_verified_ = true;
+    } else if (resyncs_ < kMaxTabResyncs && Resync(result)) {
+        QLOG_WARN() << "Tabs were renamed or re-ordered in game during the update, fetching the changed ones again";
+        FetchItems();
+        EmitStatus(Paused());
+        // Adopted a list that was just fetched, if nothing is left to do it's as good as verified
+        tab_list_verified_ = total_completed_ == total_needed_;
+    } else {
+        QLOG_ERROR() << "You renamed or re-ordered tabs in game while acquisition was in the middle of the update,"
+                     << " aborting to prevent synchronization problems and pricing data loss.";
+        cancel_update_ = true;
+        if (replies_.empty())
+            updating_ = false;
+        EmitStatus(false);
+        return;
+    }
+    CheckCompletion();
+}
 
-        // DataStore is thread safe so it's ok to call it here
-        data_.Set("items", items_as_string);
-        data_.Set("tabs", tabs_as_string_);
+void ItemsManagerWorker::FinishUpdate() {
+    // Parsing finishes in whatever order the pool gets to it, merge in location order
+    // so the rest of the application always sees the same item list for the same data.
+    items_.clear();
+    std::map<std::string, QByteArray> fingerprints;
+    for (auto &location : location_items_) {
+        items_.insert(items_.end(), location.second.begin(), location.second.end());
+        auto it = fingerprints_.find(location.first.GetHeader());
+        if (it != fingerprints_.end())
+            fingerprints.insert(*it);
+    }
+    // Forget tabs and characters that are gone
+    fingerprints_.swap(fingerprints);
+
+    // It's possible that we receive character vs stash tabs out of order, or users
+    // move items around in a tab and we get them in a different order. For
+    // consistency we want to present the tab data in a deterministic way to the rest
+    // of the application.  Especially so we don't try to update shop when nothing actually
+    // changed.  So sort items_ here before emitting.
+    SortItems(&items_);
+
+    // all requests completed
+    emit ItemsRefreshed(items_, tabs_, false, false);
+
+    // SqliteDataStore serializes the GUI's writes with ours, the locations go in as one
+    // transaction nothing else can end up in.  Only locations that changed are written.
+    StoreLocations(location_items_);
+    location_items_.clear();
+    data_.Set("tabs", tabs_as_string_);
+
+    updating_ = false;
+    QLOG_DEBUG() << "Finished updating stash.";
+    qint64 skipped = rate_limiter_->skipped_msecs() - update_skipped_msecs_;
+    QLOG_INFO() << "Update of" << total_needed_ << "tabs and characters took" << update_timer_.elapsed() << "ms";
+    if (skipped > 0)
+        QLOG_INFO() << "Virtual time skipped" << skipped << "ms of rate limit waits";
+    if (AllocationStats::Enabled()) {
+        AllocationStats allocations = AllocationStats::Current() - update_allocations_;
+        QLOG_INFO() << "Update made" << allocations.count << "allocations of" << allocations.bytes << "bytes for"
+                    << items_.size() << "items";
+    }
+    TabCacheStats cache = tab_cache_->Stats();
+    QLOG_DEBUG() << "Tab cache served" << cache.refresh_hits << "of" << cache.refresh_hits + cache.refresh_misses
+                 << "replies, it holds" << cache.entries << "entries in" << cache.size << "bytes";
 
-        updating_ = false;
-        QLOG_DEBUG() << "Finished updating stash.";
+    PreserveSelectedCharacter();
+}
 
-        // if we're at the verge of getting throttled, sleep so we don't
-        if (requests_completed_ == kThrottleRequests)
-            QTimer::singleShot(kThrottleSleep, this, SLOT(PreserveSelectedCharacter()));
-        else
-            PreserveSelectedCharacter();
-    }
+bool ItemsManagerWorker::Paused() {
+    bool tabs = !queue_.empty(), characters = !character_queue_.empty();
+    if (!tabs && !characters)
+        return false;
+    return (!tabs || rate_limiter_->IsThrottled()) && (!characters || character_limiter_->IsThrottled());
+}
+
+void ItemsManagerWorker::EmitStatus(bool throttled) {
+    if (throttled)
+        QLOG_DEBUG() << "Throttled, next stash request in" << rate_limiter_->MsecsUntilNextRequest()
+                     << "ms, next character request in" << character_limiter_->MsecsUntilNextRequest() << "ms";
 
-    reply.network_reply->deleteLater();
+    CurrentStatusUpdate status = CurrentStatusUpdate();
+    status.state = throttled ? ProgramState::ItemsPaused : ProgramState::ItemsReceive;
+    status.progress = total_completed_;
+    status.total = total_needed_;
+    status.cached = total_cached_;
+    if (total_completed_ == total_needed_)
+        status.state = ProgramState::ItemsCompleted;
+    if (cancel_update_)
+        status.state = ProgramState::UpdateCancelled;
+    emit StatusUpdate(status);
 }
 
 void ItemsManagerWorker::PreserveSelectedCharacter() {
-    if (selected_character_.empty())
+    // The character lane fetches the active character last, so usually there's nothing to do.
+    // A retry that finds another one already went out or an update running has nothing to do either.
+    if (updating_ || selected_character_.empty() || last_character_fetched_ == selected_character_)
         return;
-    network_manager_.get(MakeCharacterRequest(selected_character_, ItemLocation()));
+    if (!character_limiter_->TryAcquire()) {
+        QTimer::singleShot(character_limiter_->MsecsUntilNextRequest(), this, SLOT(PreserveSelectedCharacter()));
+        return;
+    }
+    last_character_fetched_ = selected_character_;
+    QNetworkReply *reply = network_manager_.get(MakeCharacterRequest(selected_character_, ItemLocation()));
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        character_limiter_->Update(reply);
+        reply->deleteLater();
+    });
 }
 
 
 std::vector<std::pair<std::string, std::string> > ItemsManagerWorker::CreateTabsSignatureVector(std::string tabs) {
-    std::vector<std::pair<std::string, std::string> > tmp;
     rapidjson::Document doc;
 
     if (doc.Parse(tabs.c_str()).HasParseError()) {
         QLOG_ERROR() << "Malformed tabs data:" << tabs.c_str() << "The error was"
             << rapidjson::GetParseError_En(doc.GetParseError());
-    } else {
-        for (auto &tab : doc) {
-            std::string name = (tab.HasMember("n") && tab["n"].IsString()) ? tab["n"].GetString(): "UNKNOWN_NAME";
-            std::string uid = (tab.HasMember("id") && tab["id"].IsString()) ? tab["id"].GetString(): "UNKNOWN_ID";
-            tmp.emplace_back(name,uid);
-        }
+        return TabsSignature();
     }
-    return tmp;
+    return TabParser::CreateTabsSignature(doc);
 }
-
@@ -19,14 +19,17 @@
 
 #pragma once
 
-#include <queue>
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
 #include <QObject>
 
+#include "allocationstats.h"
 #include "util.h"
 #include "item.h"
 #include "mainwindow.h"
+#include "networkcapture.h"
+#include "ratelimiter.h"
+#include "tabparser.h"
 
 class Application;
 class DataStore;
@@ -36,19 +39,20 @@ class QTimer;
 class BuyoutManager;
 class TabCache;
 
-const int kThrottleRequests = 45;
-const int kThrottleSleep = 60;
 const int kMaxCacheSize = (1000*1024*1024); // 1GB
 
 struct ItemsRequest {
     int id;
     QNetworkRequest network_request;
     ItemLocation location;
+    // tab list the request was made for, see ItemsManagerWorker::Resync
+    int epoch{0};
 };
 
 struct ItemsReply {
     QNetworkReply *network_reply;
     ItemsRequest request;
+    bool from_cache{false};
 };
 
 class ItemsManagerWorker : public QObject {
@@ -56,47 +60,163 @@ class ItemsManagerWorker : public QObject {
 public:
     ItemsManagerWorker(Application &app, QThread *thread);
     ~ItemsManagerWorker();
+    // Scheme and host of the API, e.g. "https://www.pathofexile.com".  Only affects workers created afterwards.
+    static void SetApiRoot(const std::string &root);
+    // path on the configured API root
+    static QUrl ApiUrl(const char *path);
+    TabCache &tab_cache() { return *tab_cache_; }
 public slots:
     void Init();
     void Update(TabSelection::Type type, const std::vector<ItemLocation> &tab_names = std::vector<ItemLocation>());
 public slots:
     void OnMainPageReceived();
     void OnCharacterListReceived();
+    void FetchFirstTab();
     void OnFirstTabReceived();
     void OnTabReceived(int index);
+    void OnTabParsed(std::shared_ptr<ParsedReply> result);
+    // A location of the items stored by the last session was built, see Init
+    void OnStoredParsed(std::shared_ptr<ParsedReply> result);
     /*
-    * Makes 45 requests at once, should be called every minute.
-    * These values are approximated (GGG throttles requests)
-    * based on some quick testing.
+    * Sends queued requests for as long as the rate limiter allows and
+    * schedules itself to continue once the next request can go out.
     */
-    void FetchItems(int limit = kThrottleRequests);
+    void FetchItems();
+    // Same for the character lane, which doesn't wait for the tab list and has its own budget
+    void FetchCharacters();
+    // Fetches the active character once more if the update didn't end with it
     void PreserveSelectedCharacter();
+    // Fetches the tab list once everything else is done to make sure it didn't change during the update
+    void VerifyTabList();
+    void OnTabListVerified();
 signals:
-    void ItemsRefreshed(const Items &items, const std::vector<ItemLocation> &tabs, bool initial_refresh);
+    // complete is false if some of the stored items couldn't be loaded, and for updates
+    void ItemsRefreshed(const Items &items, const std::vector<ItemLocation> &tabs, bool initial_refresh, bool complete);
+    // Emitted as soon as a single tab or character is received: its items should replace
+    // whatever was known about that location before
+    void LocationRefreshed(const ItemLocation &location, const Items &items);
+    // The items shown for these locations are what the last update found, they're being checked now
+    void LocationsStale(const std::vector<ItemLocation> &locations);
+    // The location was received again and nothing changed, the items already shown stay
+    void LocationRevalidated(const ItemLocation &location);
     void StatusUpdate(const CurrentStatusUpdate &status);
 private:
 
+    // Emits ItemsRefreshed once every stored item is built
+    void FinishLoad();
+    // Location of the tab or character the item location is in
+    static ItemLocation TabLocation(const ItemLocation &location);
     QNetworkRequest MakeTabRequest(int tab_index, const ItemLocation &location, bool tabs = false, bool refresh = false);
     QNetworkRequest MakeCharacterRequest(const std::string &name, const ItemLocation &location);
+    // Characters go to character_queue_, stash tabs to queue_
     void QueueRequest(const QNetworkRequest &request, const ItemLocation &location);
-    void ParseItems(rapidjson::Value *value_ptr, const ItemLocation &base_location, rapidjson_allocator &alloc);
+    // Lower is fetched earlier, see kPriority* constants
+    int RequestPriority(const ItemsRequest &request) const;
+    std::vector<ItemsRequest>::iterator NextRequest(std::vector<ItemsRequest> *queue);
+    void Send(const ItemsRequest &request);
+    RateLimiter &Limiter(const ItemLocation &location);
+    // Moves given locations to the front of a running update and makes sure they're refreshed
+    void Reprioritize(const std::vector<ItemLocation> &locations);
+    void ScheduleFetch();
+    // Finishes the update if every request is done and the tab list was verified
+    void CheckCompletion();
+    void FinishUpdate();
+    // True if the request asks for the tab list along with the tab
+    static bool HasTabList(const QNetworkRequest &request);
+    // Replaces tabs_, tabs_signature_, tab_hashes_ and tabs_as_string_ with the "tabs" member of a reply
+    void SetTabs(const rapidjson::Value &tabs);
+    // Takes the tab list from the first tab of an update and queues the rest of the tabs
+    void OnFirstTabParsed(const ParsedReply &result);
+    // Adopts the tab list of a reply that doesn't match the one the update started with.  Completed
+    // tabs that are still at the same index under the same name are kept, the rest is fetched again.
+    // Returns false if the reply has no usable tab list.
+    bool Resync(const ParsedReply &result);
+    // True for stash requests that were made for a tab list which is out of date now
+    bool IsStale(const ItemsRequest &request) const;
+    // Lets the parser reuse items loaded from the data store for replies that didn't change since
+    void SeedParser(const std::map<ItemLocation, Items> &locations);
+    // Reads the "fingerprints" of older versions, kept next to the items in the data store now
+    void ParseFingerprints(const std::string &fingerprints);
+    // Writes the items of locations that changed since they were stored and deletes the ones that are gone,
+    // locations are tabs and characters.  False if the data store failed to.
+    bool StoreLocations(const std::map<ItemLocation, Items> &locations);
     std::vector<std::pair<std::string, std::string> > CreateTabsSignatureVector(std::string tabs);
+    void EmitStatus(bool throttled);
+    // True if neither lane can send anything: each one either has nothing queued or waits on its
+    // own limiter, and at least one of them waits
+    bool Paused();
 
     QNetworkRequest Request(QUrl url, const ItemLocation &location, TabCache::Flags flags = TabCache::None);
     DataStore &data_;
-    QNetworkAccessManager network_manager_;
+    CaptureNetworkAccessManager network_manager_;
     QSignalMapper *signal_mapper_;
     std::vector<ItemLocation> tabs_;
-    std::queue<ItemsRequest> queue_;
+    // pending stash requests, FetchItems picks them in RequestPriority order
+    std::vector<ItemsRequest> queue_;
+    // pending character requests, see FetchCharacters
+    std::vector<ItemsRequest> character_queue_;
+    // when each location (by header) was last received, so the stalest ones go first
+    std::map<std::string, qint64> last_fetched_;
+    // requests that were sent and are either waiting for a reply or being parsed
     std::map<int, ItemsReply> replies_;
+    TabParser parser_;
+    // items received during this update, kept per location so they're merged in a fixed order
+    std::map<ItemLocation, Items> location_items_;
+    // parser fingerprint of the last reply for every location (by header), kept in the data store
+    std::map<std::string, QByteArray> fingerprints_;
+    // fingerprint of what the data store has for every location, empty if it was stored without one
+    std::map<std::string, QByteArray> stored_fingerprints_;
     // tabs_signature_ captures <"n", "id"> from JSON tab list, used as consistency check
     std::vector<std::pair<std::string, std::string> > tabs_signature_;
+    // hash of every entry of tabs_signature_, what replies are actually checked against
+    TabHashes tab_hashes_;
     bool cancel_update_{false};
+    // bumped every time the tab list changes during an update
+    int epoch_{0};
+    // how many times the current update had to resync the tab list
+    int resyncs_{0};
+    // failed attempts at verifying the tab list at the end of the current update
+    int tab_list_failures_{0};
+    // request_id the first tab of the current update was handed to the parser with
+    int first_tab_request_{-1};
+    // set once the tab list of the current update is known and tab requests are queued
+    bool tab_list_received_{false};
+    // set once the tab list was fetched again at the end of the update and didn't change
+    bool tab_list_verified_{false};
     Items items_;
     int total_completed_, total_needed_, total_cached_;
-    int requests_completed_, requests_needed_;
-    int cached_requests_completed_{0};
-    
+    // shared with the workers of every other league of this account
+    std::shared_ptr<RateLimiter> rate_limiter_;
+    // character inventories are limited separately from stash tabs
+    std::shared_ptr<RateLimiter> character_limiter_;
+    // measures how long the current update takes
+    QElapsedTimer update_timer_;
+    qint64 update_skipped_msecs_{0};
+    // allocations when the current update started, see AllocationStats
+    AllocationStats update_allocations_;
+    // true if the items of the last session came from the single "items" array of older versions
+    bool load_legacy_{false};
+    // Locations of the last session still being built on the pool
+    bool loading_{false};
+    int locations_pending_{0};
+    // keys of the stored locations by the id they were handed to the parser with
+    std::vector<std::string> loading_keys_;
+    // set if the "items" array of older versions couldn't be read
+    bool load_failed_{false};
+    // set if any of the stored items were lost, load_failed_ or a malformed location
+    bool load_incomplete_{false};
+    QElapsedTimer load_timer_;
+    AllocationStats load_allocations_;
+    // Update requested while loading
+    bool update_after_load_{false};
+    TabSelection::Type deferred_selection_;
+    std::vector<ItemLocation> deferred_locations_;
+    // true if FetchItems is already scheduled to run
+    bool fetch_scheduled_{false};
+    bool character_fetch_scheduled_{false};
+    // character the server saw a request for last, it's the one selected in game now
+    std::string last_character_fetched_;
+
     std::string tabs_as_string_;
     std::string league_;
     // set to true if updating right now
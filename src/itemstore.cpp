@@ -0,0 +1,102 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "itemstore.h"
+
+#include <limits>
+#include <map>
+
+ItemStore::ItemStore(const Items &items) :
+    items_(items)
+{
+    size_t rows = items_.size();
+    for (auto &column : attributes_)
+        column.resize(rows);
+    sockets_r_.resize(rows);
+    sockets_g_.resize(rows);
+    sockets_b_.resize(rows);
+    sockets_w_.resize(rows);
+    has_mtx_.resize(rows);
+    hashes_.resize(rows);
+    category_ids_.resize(rows);
+    location_ids_.resize(rows);
+
+    // Categories are interned, the address of the text identifies them
+    std::unordered_map<const std::string*, uint32_t> category_ids;
+    std::map<ItemLocation, std::vector<uint32_t>> location_rows;
+    for (size_t row = 0; row < rows; ++row) {
+        const Item &item = *items_[row];
+        attributes_[ILVL][row] = item.ilvl();
+        attributes_[LINKS][row] = item.links_cnt();
+        attributes_[SOCKETS][row] = item.sockets_cnt();
+        attributes_[DPS][row] = item.DPS();
+        attributes_[PDPS][row] = item.pDPS();
+        attributes_[EDPS][row] = item.eDPS();
+        const ItemSocketGroup &sockets = item.sockets();
+        sockets_r_[row] = static_cast<uint8_t>(sockets.r);
+        sockets_g_[row] = static_cast<uint8_t>(sockets.g);
+        sockets_b_[row] = static_cast<uint8_t>(sockets.b);
+        sockets_w_[row] = static_cast<uint8_t>(sockets.w);
+        has_mtx_[row] = item.has_mtx();
+        hashes_[row] = item.hash();
+
+        const std::string *category = &item.category();
+        auto it = category_ids.find(category);
+        if (it == category_ids.end()) {
+            it = category_ids.insert({ category, static_cast<uint32_t>(categories_.size()) }).first;
+            categories_.push_back(*category);
+        }
+        category_ids_[row] = it->second;
+
+        location_rows[item.location()].push_back(static_cast<uint32_t>(row));
+    }
+
+    for (auto &location : location_rows) {
+        uint32_t id = static_cast<uint32_t>(locations_.size());
+        locations_.push_back(location.first);
+        for (uint32_t row : location.second)
+            location_ids_[row] = id;
+    }
+}
+
+const std::vector<double> &ItemStore::property(const InternedString &name) const {
+    auto it = properties_.find(name);
+    if (it != properties_.end())
+        return it->second;
+    std::vector<double> &column = properties_[name];
+    column.resize(items_.size(), std::numeric_limits<double>::quiet_NaN());
+    for (size_t row = 0; row < items_.size(); ++row) {
+        const ItemNumericProperty *property = items_[row]->property(name);
+        if (property && property->numeric)
+            column[row] = property->min;
+    }
+    return column;
+}
+
+const std::vector<double> &ItemStore::requirement(const InternedString &name) const {
+    auto it = requirements_.find(name);
+    if (it != requirements_.end())
+        return it->second;
+    std::vector<double> &column = requirements_[name];
+    column.resize(items_.size());
+    for (size_t row = 0; row < items_.size(); ++row)
+        column[row] = items_[row]->requirement(name);
+    return column;
+}
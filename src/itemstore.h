@@ -0,0 +1,89 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "item.h"
+
+/*
+ * What searches filter on, kept column by column: one contiguous array per
+ * attribute with a row for every item, rows in the order of the items the store
+ * was built from.  Filters scan these instead of following a pointer to every
+ * item (see Filter::Select).  Property and requirement columns are built the
+ * first time a filter asks for them.
+ *
+ * Built on and used from the GUI thread only, it's rebuilt whenever the item
+ * list changes.
+ */
+class ItemStore {
+public:
+    // Numeric attributes every item has
+    enum Attribute {
+        ILVL,
+        LINKS,
+        SOCKETS,
+        DPS,
+        PDPS,
+        EDPS,
+        ATTRIBUTE_COUNT
+    };
+
+    ItemStore() {}
+    explicit ItemStore(const Items &items);
+    size_t size() const { return items_.size(); }
+    const Items &items() const { return items_; }
+    const std::shared_ptr<Item> &item(size_t row) const { return items_[row]; }
+
+    const std::vector<double> &attribute(Attribute attribute) const { return attributes_[attribute]; }
+    // Colours of all sockets of the item, see Item::sockets
+    const std::vector<uint8_t> &sockets_r() const { return sockets_r_; }
+    const std::vector<uint8_t> &sockets_g() const { return sockets_g_; }
+    const std::vector<uint8_t> &sockets_b() const { return sockets_b_; }
+    const std::vector<uint8_t> &sockets_w() const { return sockets_w_; }
+    const std::vector<uint8_t> &has_mtx() const { return has_mtx_; }
+    // Buyout key of every row
+    const std::vector<ItemHash> &hashes() const { return hashes_; }
+    // Index into categories() and locations(), the latter are in ItemLocation order
+    const std::vector<uint32_t> &category_ids() const { return category_ids_; }
+    const std::vector<InternedString> &categories() const { return categories_; }
+    const std::vector<uint32_t> &location_ids() const { return location_ids_; }
+    const std::vector<ItemLocation> &locations() const { return locations_; }
+
+    // Leading number of the property, NaN for rows that don't have it or where it isn't a number
+    const std::vector<double> &property(const InternedString &name) const;
+    // Same as Item::requirement, 0 where there's none
+    const std::vector<double> &requirement(const InternedString &name) const;
+private:
+    Items items_;
+    std::vector<double> attributes_[ATTRIBUTE_COUNT];
+    std::vector<uint8_t> sockets_r_, sockets_g_, sockets_b_, sockets_w_;
+    std::vector<uint8_t> has_mtx_;
+    std::vector<ItemHash> hashes_;
+    std::vector<uint32_t> category_ids_;
+    std::vector<InternedString> categories_;
+    std::vector<uint32_t> location_ids_;
+    std::vector<ItemLocation> locations_;
+    mutable std::unordered_map<InternedString, std::vector<double>> properties_;
+    mutable std::unordered_map<InternedString, std::vector<double>> requirements_;
+};
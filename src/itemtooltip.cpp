@@ -54,11 +54,14 @@ std::vector<std::string> kPoEColors = {
     "#d02090"
 };
 
-static std::string ColorPropertyValue(const ItemPropertyValue &value) {
-    size_t type = value.type;
+static std::string ColorPropertyValue(const std::string &text, size_t type) {
     if (type >= kPoEColors.size())
         type = 0;
-    return "<font color='" + kPoEColors[type] + "'>" + value.str + "</font>";
+    return "<font color='" + kPoEColors[type] + "'>" + text + "</font>";
+}
+
+static std::string ColorPropertyValue(const ItemPropertyValue &value) {
+    return ColorPropertyValue(value.str, value.type);
 }
 
 static std::string FormatProperty(const ItemProperty &prop) {
@@ -119,14 +122,13 @@ static std::string ModListAsString(const ItemMods &list) {
     }
     if (mods.empty())
         return "";
-    return ColorPropertyValue(ItemPropertyValue{ mods, 1 });
+    return ColorPropertyValue(mods, 1);
 }
 
 static std::vector<std::string> GenerateMods(const Item &item) {
     std::vector<std::string> out;
-    auto &mods = item.text_mods();
     for (auto &mod_type : ITEM_MOD_TYPES) {
-        std::string mod_list = ModListAsString(mods.at(mod_type));
+        std::string mod_list = ModListAsString(item.text_mods(mod_type));
         if (!mod_list.empty())
             out.push_back(mod_list);
     }
@@ -153,7 +155,7 @@ static std::string GenerateItemInfo(const Item &item, const std::string &key, bo
     if (item.corrupted())
         unmet += (unmet.empty() ? "" : "<br>") + std::string("Corrupted");
     if (!unmet.empty())
-        sections.push_back(ColorPropertyValue(ItemPropertyValue{ unmet, 2 }));
+        sections.push_back(ColorPropertyValue(unmet, 2));
 
     std::string text;
     bool first = true;
@@ -169,7 +171,7 @@ static std::string GenerateItemInfo(const Item &item, const std::string &key, bo
         text += s;
     }
     if (!fancy)
-        text = ColorPropertyValue(ItemPropertyValue{ item.PrettyName(), 0 }) + "<hr>" + text;
+        text = ColorPropertyValue(item.PrettyName(), 0) + "<hr>" + text;
     return "<center>" + text + "</center>";
 }
 
@@ -42,6 +42,7 @@
 #include "application.h"
 #include "filesystem.h"
 #include "mainwindow.h"
+#include "networkcapture.h"
 #include "replytimeout.h"
 #include "selfdestructingreply.h"
 #include "steamlogindialog.h"
@@ -78,7 +79,7 @@ LoginDialog::LoginDialog(std::unique_ptr<Application> app) :
     settings_path_ = Filesystem::UserDir() + "/settings.ini";
     LoadSettings();
 
-    login_manager_ = std::make_unique<QNetworkAccessManager>();
+    login_manager_ = std::make_unique<CaptureNetworkAccessManager>();
     connect(ui->proxyCheckBox, SIGNAL(clicked(bool)), this, SLOT(OnProxyCheckBoxClicked(bool)));
     connect(ui->loginButton, SIGNAL(clicked()), this, SLOT(OnLoginButtonClicked()));
     connect(&update_checker_, &UpdateChecker::UpdateAvailable, [&](){
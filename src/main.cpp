@@ -34,7 +34,10 @@
 #include "filesystem.h"
 #include "itemsmanagerworker.h"
 #include "modlist.h"
+#include "networkcapture.h"
 #include "porting.h"
+#include "ratelimiter.h"
+#include "tabparser.h"
 #include "version.h"
 #include "../test/testmain.h"
 #include "tabcache.h"
@@ -49,8 +52,10 @@ int main(int argc, char *argv[])
     qRegisterMetaType<Items>("Items");
     qRegisterMetaType<std::vector<std::string>>("std::vector<std::string>");
     qRegisterMetaType<std::vector<ItemLocation>>("std::vector<ItemLocation>");
+    qRegisterMetaType<ItemLocation>("ItemLocation");
     qRegisterMetaType<QsLogging::Level>("QsLogging::Level");
     qRegisterMetaType<TabSelection::Type>("TabSelection::Type");
+    qRegisterMetaType<std::shared_ptr<ParsedReply>>("std::shared_ptr<ParsedReply>");
 
     QLocale::setDefault(QLocale::C);
     std::setlocale(LC_ALL, "C");
@@ -85,12 +90,28 @@ int main(int argc, char *argv[])
 
     QCommandLineParser parser;
     QCommandLineOption option_test("test"), option_data_dir("data-dir", "Where to save Acquisition data.", "data-dir");
+    QCommandLineOption option_capture("capture", "Record API traffic to a file.", "file");
+    QCommandLineOption option_replay("replay", "Serve API traffic from a file recorded with --capture.", "file");
+    QCommandLineOption option_virtual_time("virtual-time", "Don't wait for rate limits, replay as fast as possible.");
+    QCommandLineOption option_load_test("load-test", "Time a full update of a mock account with <tabs>x<items per tab>.", "size");
     parser.addOption(option_test);
     parser.addOption(option_data_dir);
+    parser.addOption(option_capture);
+    parser.addOption(option_replay);
+    parser.addOption(option_virtual_time);
+    parser.addOption(option_load_test);
     parser.process(a);
 
     if (parser.isSet(option_test))
         return test_main();
+    if (parser.isSet(option_load_test)) {
+        QStringList size = parser.value(option_load_test).split('x');
+        if (size.size() != 2) {
+            qCritical() << "Load test size should look like 200x50";
+            return -1;
+        }
+        return load_test_main(size[0].toInt(), size[1].toInt());
+    }
 
     if (parser.isSet(option_data_dir))
         Filesystem::SetUserDir(parser.value(option_data_dir).toStdString());
@@ -109,6 +130,15 @@ int main(int argc, char *argv[])
     QLOG_DEBUG() << "-------------------------------------------------------------------------------";
     QLOG_DEBUG() << "Built with Qt" << QT_VERSION_STR << "running on" << qVersion();
 
+    if (parser.isSet(option_capture))
+        NetworkCapture::StartRecording(parser.value(option_capture).toStdString());
+    if (parser.isSet(option_replay)) {
+        bool virtual_time = parser.isSet(option_virtual_time);
+        if (!NetworkCapture::StartReplay(parser.value(option_replay).toStdString(), virtual_time))
+            return -1;
+        RateLimiter::SetVirtualTime(virtual_time);
+    }
+
     LoginDialog login(std::make_unique<Application>());
     login.show();
 
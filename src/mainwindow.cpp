@@ -20,6 +20,7 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -40,6 +41,7 @@
 
 #include "application.h"
 #include "buyoutmanager.h"
+#include "cachestatsdialog.h"
 #include "currencymanager.h"
 #include "datastore.h"
 #include "filesystem.h"
@@ -61,7 +63,7 @@
 
 const std::string POE_WEBCDN = "http://webcdn.pathofexile.com";
 
-MainWindow::MainWindow(std::unique_ptr<Application> app):
+MainWindow::MainWindow(std::unique_ptr<Application> app, MainWindow *owner):
     app_(std::move(app)),
     ui(new Ui::MainWindow),
     current_search_(nullptr),
@@ -77,10 +79,15 @@ MainWindow::MainWindow(std::unique_ptr<Application> app):
     setWindowIcon(QIcon(":/icons/assets/icon.svg"));
 #endif
 
-    image_cache_ = new ImageCache(Filesystem::UserDir() + "/cache");
+    if (owner)
+        image_cache_ = owner->image_cache_;
+    else
+        image_cache_ = std::make_shared<ImageCache>(Filesystem::UserDir() + "/cache");
 
     InitializeUi();
-    InitializeLogging();
+    // The logger is global, messages of every league already show up in the owner's log panel
+    if (!owner)
+        InitializeLogging();
     InitializeSearchForm();
     NewSearch();
 
@@ -89,6 +96,8 @@ MainWindow::MainWindow(std::unique_ptr<Application> app):
             this, SLOT(OnImageFetched(QNetworkReply*)));
 
     connect(&app_->items_manager(), &ItemsManager::ItemsRefreshed, this, &MainWindow::OnItemsRefreshed);
+    connect(&app_->items_manager(), &ItemsManager::LocationRefreshed, this, &MainWindow::OnLocationRefreshed);
+    connect(&app_->items_manager(), &ItemsManager::LocationStaleChanged, this, &MainWindow::OnLocationStaleChanged);
     connect(&app_->items_manager(), &ItemsManager::StatusUpdate, this, &MainWindow::OnStatusUpdate);
     connect(&app_->shop(), &Shop::StatusUpdate, this, &MainWindow::OnStatusUpdate);
     connect(&update_checker_, &UpdateChecker::UpdateAvailable, this, &MainWindow::OnUpdateAvailable);
@@ -380,7 +389,7 @@ void MainWindow::OnStatusUpdate(const CurrentStatusUpdate &status) {
     case ProgramState::ItemsPaused:
         title = QString("Receiving stash data, %1/%2 [%3 from cache]").arg(status.progress).arg(status.total).arg(status.cached);
         if (status.state == ProgramState::ItemsPaused)
-            title += " (throttled, sleeping 60 seconds)";
+            title += " (throttled, waiting for the API rate limit)";
         need_progress = true;
         break;
     case ProgramState::ItemsCompleted:
@@ -477,7 +486,7 @@ void MainWindow::ModelViewRefresh() {
 
     previous_search_ = current_search_;
 
-    current_search_->Activate(app_->items_manager().items());
+    current_search_->Activate(app_->items_manager().store());
 
     ui->viewComboBox->setCurrentIndex(static_cast<int>(current_search_->GetViewMode()));
 
@@ -568,9 +577,9 @@ void MainWindow::InitializeSearchForm() {
         // Offense
         // new DamageFilter(offense_layout, "Damage"),
         std::make_unique<SimplePropertyFilter>(offense_layout, "Critical Strike Chance", "Crit."),
-        std::make_unique<ItemMethodFilter>(offense_layout, [](Item* item) { return item->DPS(); }, "DPS"),
-        std::make_unique<ItemMethodFilter>(offense_layout, [](Item* item) { return item->pDPS(); }, "pDPS"),
-        std::make_unique<ItemMethodFilter>(offense_layout, [](Item* item) { return item->eDPS(); }, "eDPS"),
+        std::make_unique<ItemMethodFilter>(offense_layout, [](Item* item) { return item->DPS(); }, "DPS", ItemStore::DPS),
+        std::make_unique<ItemMethodFilter>(offense_layout, [](Item* item) { return item->pDPS(); }, "pDPS", ItemStore::PDPS),
+        std::make_unique<ItemMethodFilter>(offense_layout, [](Item* item) { return item->eDPS(); }, "eDPS", ItemStore::EDPS),
         std::make_unique<SimplePropertyFilter>(offense_layout, "Attacks per Second", "APS"),
         // Defense
         std::make_unique<SimplePropertyFilter>(defense_layout, "Armour"),
@@ -601,7 +610,7 @@ void MainWindow::InitializeSearchForm() {
 }
 
 void MainWindow::NewSearch() {
-    SetCurrentSearch(new Search(app_->buyout_manager(), QString("Search %1").arg(++search_count_).toStdString(), filters_, ui->treeView));
+    SetCurrentSearch(new Search(app_->buyout_manager(), app_->items_manager(), QString("Search %1").arg(++search_count_).toStdString(), filters_, ui->treeView));
     current_search_->SetRefreshReason(RefreshReason::TabCreated);
 
     tab_bar_->setTabText(tab_bar_->count() - 1, current_search_->GetCaption());
@@ -687,7 +696,7 @@ void MainWindow::OnItemsRefreshed() {
         search->SetRefreshReason(RefreshReason::ItemsChanged);
         // Don't update current search - it will be updated in OnSearchFormChange
         if (search != current_search_) {
-            search->FilterItems(app_->items_manager().items());
+            search->FilterItems(app_->items_manager().store());
             tab_bar_->setTabText(tab, search->GetCaption());
         }
         tab++;
@@ -701,7 +710,27 @@ void MainWindow::OnItemsRefreshed() {
     ModelViewRefresh();
 }
 
+void MainWindow::OnLocationRefreshed(const ItemLocation &location, const Items &items) {
+    // Only touch what belongs to this location, the full refresh at the end of
+    // the update takes care of categories and everything else
+    int tab = 0;
+    for (auto search : searches_) {
+        search->UpdateLocation(location, items, app_->items_manager().items());
+        tab_bar_->setTabText(tab, search->GetCaption());
+        tab++;
+    }
+}
+
+void MainWindow::OnLocationStaleChanged(const ItemLocation &location) {
+    for (auto search : searches_)
+        search->UpdateLocationTitle(location);
+}
+
 MainWindow::~MainWindow() {
+    // Copied since every deleted window removes itself from league_windows_
+    auto windows = league_windows_;
+    for (auto window : windows)
+        delete window;
     delete ui;
 #ifdef Q_OS_WIN32
     delete taskbar_button_;
@@ -761,6 +790,28 @@ void MainWindow::on_actionItems_refresh_interval_triggered() {
         app_->items_manager().SetAutoUpdateInterval(interval);
 }
 
+void MainWindow::on_actionOpen_league_triggered() {
+    bool ok;
+    QString league = QInputDialog::getText(this, "Open league",
+        "Enter the name of another league to follow. It is refreshed alongside this one and shares the same request budget.",
+        QLineEdit::Normal, "", &ok);
+    if (!ok || league.isEmpty() || league.toStdString() == app_->league())
+        return;
+    auto window = new MainWindow(app_->OpenLeague(league.toStdString()), this);
+    window->setAttribute(Qt::WA_DeleteOnClose);
+    window->setWindowTitle(QString("Acquisition - %1").arg(league));
+    connect(window, &QObject::destroyed, this, [this, window]() {
+        league_windows_.erase(std::remove(league_windows_.begin(), league_windows_.end(), window), league_windows_.end());
+    });
+    window->show();
+    league_windows_.push_back(window);
+}
+
+void MainWindow::on_actionCache_statistics_triggered() {
+    CacheStatsDialog dialog(app_->items_manager().tab_cache(), this);
+    dialog.exec();
+}
+
 void MainWindow::on_actionRefresh_triggered() {
     // Refresh all tabs
     app_->items_manager().Update(TabSelection::All);
@@ -81,7 +81,8 @@ struct CurrentStatusUpdate {
 class MainWindow : public QMainWindow {
     Q_OBJECT
 public:
-    MainWindow(std::unique_ptr<Application> app);
+    // Windows of leagues opened from another window share its image cache and event log
+    MainWindow(std::unique_ptr<Application> app, MainWindow *owner = nullptr);
     ~MainWindow();
     std::vector<Column*> columns;
 public slots:
@@ -91,6 +92,8 @@ public slots:
     void OnTabChange(int index);
     void OnImageFetched(QNetworkReply *reply);
     void OnItemsRefreshed();
+    void OnLocationRefreshed(const ItemLocation &location, const Items &items);
+    void OnLocationStaleChanged(const ItemLocation &location);
     void OnStatusUpdate(const CurrentStatusUpdate &status);
     void OnBuyoutChange();
     void ResizeTreeColumns();
@@ -108,6 +111,8 @@ private slots:
     void on_actionForum_shop_thread_triggered();
     void on_actionCopy_shop_data_to_clipboard_triggered();
     void on_actionItems_refresh_interval_triggered();
+    void on_actionOpen_league_triggered();
+    void on_actionCache_statistics_triggered();
     void on_actionRefresh_triggered();
     void on_actionRefresh_checked_triggered();
     void on_actionAutomatically_refresh_items_triggered();
@@ -153,7 +158,7 @@ private:
     std::vector<std::unique_ptr<Filter>> filters_;
     int search_count_;
     QNetworkAccessManager *image_network_manager_;
-    ImageCache *image_cache_;
+    std::shared_ptr<ImageCache> image_cache_;
     QLabel *status_bar_label_;
     QVBoxLayout *search_form_layout_;
     QMenu context_menu_;
@@ -166,6 +171,9 @@ private:
     QTimer delayed_update_current_item_;
     QTimer delayed_search_form_change_;
     QStringListModel *category_string_model_;
+    // other leagues of this account opened from here, see Application::OpenLeague.
+    // They delete themselves along with their Application when closed.
+    std::vector<MainWindow*> league_windows_;
 #ifdef Q_OS_WIN32
     QWinTaskbarButton *taskbar_button_;
 #endif
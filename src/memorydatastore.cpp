@@ -55,3 +55,18 @@ void MemoryDataStore::SetInt(const std::string &key, int value) {
 int MemoryDataStore::GetInt(const std::string &key, int default_value) {
     return std::stoi(Get(key, std::to_string(default_value)));
 }
+
+std::vector<StoredLocation> MemoryDataStore::GetLocations() {
+    std::vector<StoredLocation> result;
+    for (auto &location : locations_)
+        result.push_back(location.second);
+    return result;
+}
+
+bool MemoryDataStore::SetLocations(const std::vector<StoredLocation> &locations, const std::vector<std::string> &removed) {
+    for (auto &location : locations)
+        locations_[location.key] = location;
+    for (auto &key : removed)
+        locations_.erase(key);
+    return true;
+}
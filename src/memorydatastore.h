@@ -35,7 +35,10 @@ public:
     bool GetBool(const std::string &key, bool default_value = false);
     void SetInt(const std::string &key, int value);
     int GetInt(const std::string &key, int default_value = 0);
+    std::vector<StoredLocation> GetLocations();
+    bool SetLocations(const std::vector<StoredLocation> &locations, const std::vector<std::string> &removed);
 private:
     std::map<std::string, std::string> data_;
     std::vector<CurrencyUpdate> currency_updates_;
+    std::map<std::string, StoredLocation> locations_;
 };
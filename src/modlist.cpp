@@ -159,5 +159,5 @@ void SumModGenerator::Generate(const rapidjson::Value &json, ModTable *output) {
     }
 
     if (mod_present)
-        (*output)[name_] = sum;
+        output->push_back({ name_, sum });
 }
@@ -21,13 +21,17 @@
 
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <QStringList>
 #include "rapidjson/document.h"
 
+#include "internedstring.h"
+#include "itemarena.h"
+
 class Item;
-typedef std::unordered_map<std::string, double> ModTable;
+// Same as in item.h
+typedef ArenaVector<std::pair<InternedString, double>> ModTable;
 
 // This generates regular expressions for mods and does other setup, should be called when the app starts, perhaps in main()
 // Maybe this is not needed and constexpr could do the trick, but VS doesn't support it right now.
@@ -45,7 +49,7 @@ public:
 private:
     bool Match(const char *mod, double *output);
 
-    std::string name_;
+    InternedString name_;
     std::vector<std::string> matches_;
 };
 
@@ -19,6 +19,7 @@
 
 #include "modsfilter.h"
 
+#include <algorithm>
 #include <QComboBox>
 #include <QLineEdit>
 #include <QObject>
@@ -126,9 +127,11 @@ bool ModsFilter::Matches(const std::shared_ptr<Item> &item, FilterData *data) {
         if (mod.mod.empty())
             continue;
         const ModTable &mod_table = item->mod_table();
-        if (!mod_table.count(mod.mod))
+        auto it = std::find_if(mod_table.begin(), mod_table.end(),
+            [&mod](const std::pair<InternedString, double> &entry) { return entry.first.str() == mod.mod; });
+        if (it == mod_table.end())
             return false;
-        double value = mod_table.at(mod.mod);
+        double value = it->second;
         if (mod.min_filled && value < mod.min)
             return false;
         if (mod.max_filled && value > mod.max)
@@ -0,0 +1,235 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "networkcapture.h"
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTimer>
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include "QsLog.h"
+
+// Bump if the format of entries changes
+const quint32 kCaptureMagic = 0x41435150; // "ACQP"
+const quint32 kCaptureVersion = 1;
+
+namespace {
+
+enum class Mode {
+    Off,
+    Record,
+    Replay
+};
+
+Mode mode = Mode::Off;
+bool instant_replay = false;
+QMutex mutex;
+std::unique_ptr<QFile> capture_file;
+std::unique_ptr<QDataStream> capture_stream;
+// Replies not served yet, by operation and URL in the order they were recorded
+std::map<std::pair<int, QString>, std::deque<std::shared_ptr<CapturedReply>>> captured_replies;
+
+QDataStream &operator<<(QDataStream &stream, const CapturedReply &reply) {
+    return stream << reply.operation << reply.url << reply.status << reply.from_cache
+                  << reply.headers << qCompress(reply.body) << reply.duration;
+}
+
+QDataStream &operator>>(QDataStream &stream, CapturedReply &reply) {
+    QByteArray compressed;
+    stream >> reply.operation >> reply.url >> reply.status >> reply.from_cache
+           >> reply.headers >> compressed >> reply.duration;
+    reply.body = qUncompress(compressed);
+    return stream;
+}
+
+void Record(const CapturedReply &reply) {
+    QMutexLocker locker(&mutex);
+    if (!capture_stream)
+        return;
+    *capture_stream << reply;
+    capture_file->flush();
+}
+
+std::shared_ptr<CapturedReply> Take(int operation, const QString &url) {
+    QMutexLocker locker(&mutex);
+    auto it = captured_replies.find(std::make_pair(operation, url));
+    if (it == captured_replies.end() || it->second.empty())
+        return nullptr;
+    auto reply = it->second.front();
+    // The last reply for an URL keeps being served, more requests than recorded
+    // happen when an update is replayed with different settings
+    if (it->second.size() > 1)
+        it->second.pop_front();
+    return reply;
+}
+
+}
+
+namespace NetworkCapture {
+
+bool StartRecording(const std::string &path) {
+    QMutexLocker locker(&mutex);
+    capture_file = std::make_unique<QFile>(path.c_str());
+    if (!capture_file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QLOG_ERROR() << "Can't open" << path.c_str() << "to record network traffic";
+        capture_file.reset();
+        return false;
+    }
+    capture_stream = std::make_unique<QDataStream>(capture_file.get());
+    capture_stream->setVersion(QDataStream::Qt_5_0);
+    *capture_stream << kCaptureMagic << kCaptureVersion;
+    mode = Mode::Record;
+    QLOG_INFO() << "Recording network traffic to" << path.c_str();
+    return true;
+}
+
+bool StartReplay(const std::string &path, bool instant) {
+    QMutexLocker locker(&mutex);
+    QFile file(path.c_str());
+    if (!file.open(QIODevice::ReadOnly)) {
+        QLOG_ERROR() << "Can't open network capture" << path.c_str();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (magic != kCaptureMagic || version != kCaptureVersion) {
+        QLOG_ERROR() << path.c_str() << "is not a network capture or has an unsupported version";
+        return false;
+    }
+    int count = 0;
+    captured_replies.clear();
+    while (!stream.atEnd()) {
+        auto reply = std::make_shared<CapturedReply>();
+        stream >> *reply;
+        if (stream.status() != QDataStream::Ok) {
+            QLOG_WARN() << "Network capture" << path.c_str() << "is truncated, using the first" << count << "replies";
+            break;
+        }
+        captured_replies[std::make_pair(reply->operation, reply->url)].push_back(reply);
+        ++count;
+    }
+    mode = Mode::Replay;
+    instant_replay = instant;
+    QLOG_INFO() << "Replaying" << count << "replies from" << path.c_str();
+    return true;
+}
+
+bool IsRecording() {
+    return mode == Mode::Record;
+}
+
+bool IsReplaying() {
+    return mode == Mode::Replay;
+}
+
+}
+
+CaptureNetworkAccessManager::CaptureNetworkAccessManager(QObject *parent) :
+    QNetworkAccessManager(parent)
+{}
+
+QNetworkReply *CaptureNetworkAccessManager::createRequest(Operation op, const QNetworkRequest &request, QIODevice *outgoing_data) {
+    if (NetworkCapture::IsReplaying()) {
+        auto captured = Take(op, request.url().toString());
+        if (!captured)
+            QLOG_WARN() << "Nothing to replay for" << request.url().toDisplayString();
+        int delay = (instant_replay || !captured) ? 0 : static_cast<int>(captured->duration);
+        return new ReplayReply(op, request, captured.get(), delay, this);
+    }
+
+    QNetworkReply *reply = QNetworkAccessManager::createRequest(op, request, outgoing_data);
+    if (NetworkCapture::IsRecording()) {
+        auto timer = std::make_shared<QElapsedTimer>();
+        timer->start();
+        // Connected before anyone else gets the reply, so the body is still there to peek at
+        connect(reply, &QNetworkReply::finished, reply, [reply, op, timer]() {
+            CapturedReply captured;
+            captured.operation = op;
+            captured.url = reply->request().url().toString();
+            captured.status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            captured.from_cache = reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
+            captured.headers = reply->rawHeaderPairs();
+            captured.body = reply->peek(reply->bytesAvailable());
+            captured.duration = timer->elapsed();
+            Record(captured);
+        });
+    }
+    return reply;
+}
+
+ReplayReply::ReplayReply(QNetworkAccessManager::Operation op, const QNetworkRequest &request,
+                         const CapturedReply *captured, int delay, QObject *parent) :
+    QNetworkReply(parent)
+{
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(op);
+    if (captured) {
+        for (auto &header : captured->headers)
+            setRawHeader(header.first, header.second);
+        if (captured->status > 0)
+            setAttribute(QNetworkRequest::HttpStatusCodeAttribute, captured->status);
+        setAttribute(QNetworkRequest::SourceIsFromCacheAttribute, captured->from_cache);
+        body_ = captured->body;
+        if (captured->status >= 400)
+            setError(QNetworkReply::UnknownContentError, QString("HTTP status %1").arg(captured->status));
+    } else {
+        setError(QNetworkReply::ContentNotFoundError, "Not found in network capture");
+    }
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    QTimer::singleShot(delay, this, SLOT(Finish()));
+}
+
+void ReplayReply::Finish() {
+    if (isFinished())
+        return;
+    if (error() != QNetworkReply::NoError)
+        emit QNetworkReply::error(error());
+    if (!body_.isEmpty())
+        emit readyRead();
+    setFinished(true);
+    emit finished();
+}
+
+void ReplayReply::abort() {
+    setError(QNetworkReply::OperationCanceledError, "Operation canceled");
+    Finish();
+}
+
+qint64 ReplayReply::bytesAvailable() const {
+    return body_.size() - offset_ + QIODevice::bytesAvailable();
+}
+
+qint64 ReplayReply::readData(char *data, qint64 max_size) {
+    if (offset_ >= body_.size())
+        return -1;
+    qint64 count = std::min<qint64>(max_size, body_.size() - offset_);
+    memcpy(data, body_.constData() + offset_, count);
+    offset_ += count;
+    return count;
+}
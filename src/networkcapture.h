@@ -0,0 +1,77 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <string>
+
+/*
+ * Record/replay of API traffic.
+ *
+ * When recording, every reply seen by a CaptureNetworkAccessManager is appended
+ * to the capture file: operation, URL, status, headers, compressed body and how
+ * long the request took.  When replaying, CaptureNetworkAccessManager never
+ * touches the network and answers requests from the capture instead, in the
+ * order they were recorded for every URL.  Together with RateLimiter's virtual
+ * time this makes it possible to benchmark a whole update offline.
+ */
+namespace NetworkCapture {
+bool StartRecording(const std::string &path);
+bool StartReplay(const std::string &path, bool instant);
+bool IsRecording();
+bool IsReplaying();
+}
+
+class CaptureNetworkAccessManager : public QNetworkAccessManager {
+    Q_OBJECT
+public:
+    explicit CaptureNetworkAccessManager(QObject *parent = nullptr);
+protected:
+    QNetworkReply *createRequest(Operation op, const QNetworkRequest &request, QIODevice *outgoing_data);
+};
+
+struct CapturedReply {
+    int operation;
+    QString url;
+    int status;
+    bool from_cache;
+    QList<QNetworkReply::RawHeaderPair> headers;
+    QByteArray body;
+    qint64 duration;
+};
+
+// Reply served from a capture file
+class ReplayReply : public QNetworkReply {
+    Q_OBJECT
+public:
+    ReplayReply(QNetworkAccessManager::Operation op, const QNetworkRequest &request, const CapturedReply *captured, int delay, QObject *parent);
+    void abort();
+    qint64 bytesAvailable() const;
+    bool isSequential() const { return true; }
+protected:
+    qint64 readData(char *data, qint64 max_size);
+private slots:
+    void Finish();
+private:
+    QByteArray body_;
+    qint64 offset_{0};
+};
@@ -0,0 +1,247 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ratelimiter.h"
+
+#include <QMutexLocker>
+#include <QNetworkReply>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include "QsLog.h"
+#include <boost/algorithm/string.hpp>
+
+static std::atomic<bool> virtual_time(false);
+
+void RateLimiter::SetVirtualTime(bool enabled) {
+    virtual_time = enabled;
+}
+
+RateLimiter::RateLimiter() {
+    clock_.start();
+    windows_.push_back(MakeWindow(kThrottleRequests, kThrottleSleep, kThrottleSleep));
+}
+
+static QMutex accounts_mutex;
+static std::map<std::pair<std::string, std::string>, std::weak_ptr<RateLimiter>> accounts;
+
+std::shared_ptr<RateLimiter> RateLimiter::ForAccount(const std::string &account, const std::string &lane) {
+    QMutexLocker locker(&accounts_mutex);
+    auto &entry = accounts[std::make_pair(account, lane)];
+    std::shared_ptr<RateLimiter> limiter = entry.lock();
+    if (!limiter) {
+        limiter = std::make_shared<RateLimiter>();
+        entry = limiter;
+    }
+    return limiter;
+}
+
+std::string RateLimiter::policy() const {
+    QMutexLocker locker(&mutex_);
+    return policy_;
+}
+
+qint64 RateLimiter::skipped_msecs() const {
+    QMutexLocker locker(&mutex_);
+    return skipped_;
+}
+
+qint64 RateLimiter::Now() const {
+    return clock_.elapsed() + skipped_;
+}
+
+RateLimiter::Window RateLimiter::MakeWindow(int max_hits, int period, int penalty) {
+    Window window;
+    window.max_hits = std::max(max_hits, 1);
+    window.period = std::max(period, 1);
+    window.penalty = penalty;
+    window.capacity = std::max(window.max_hits / kThrottleBurstDivisor, 1);
+    window.tokens = window.capacity;
+    window.last_refill = -1;
+    return window;
+}
+
+void RateLimiter::Refill(Window *window, qint64 now) {
+    if (window->last_refill < 0)
+        window->last_refill = now;
+    double rate = static_cast<double>(window->max_hits) / (window->period * 1000 + kThrottleMarginMsecs);
+    window->tokens = std::min<double>(window->capacity, window->tokens + (now - window->last_refill) * rate);
+    window->last_refill = now;
+
+    qint64 span = window->period * 1000 + kThrottleMarginMsecs;
+    while (!window->hits.empty() && window->hits.front() + span <= now)
+        window->hits.pop_front();
+}
+
+int RateLimiter::MsecsUntilNextRequest() {
+    QMutexLocker locker(&mutex_);
+    return WaitMsecs();
+}
+
+int RateLimiter::WaitMsecs() {
+    qint64 now = Now();
+    qint64 wait = std::max<qint64>(restricted_until_ - now, 0);
+    for (auto &window : windows_) {
+        Refill(&window, now);
+        if (window.tokens < 1) {
+            double rate = static_cast<double>(window.max_hits) / (window.period * 1000 + kThrottleMarginMsecs);
+            wait = std::max<qint64>(wait, static_cast<qint64>(std::ceil((1 - window.tokens) / rate)));
+        }
+        if (static_cast<int>(window.hits.size()) >= window.max_hits) {
+            qint64 span = window.period * 1000 + kThrottleMarginMsecs;
+            size_t oldest = window.hits.size() - window.max_hits;
+            wait = std::max<qint64>(wait, window.hits[oldest] + span - now);
+        }
+    }
+    return static_cast<int>(wait);
+}
+
+bool RateLimiter::TryAcquire() {
+    QMutexLocker locker(&mutex_);
+    int wait;
+    while ((wait = WaitMsecs()) > 0) {
+        if (!virtual_time)
+            return false;
+        skipped_ += wait;
+    }
+    qint64 now = Now();
+    for (auto &window : windows_) {
+        window.tokens -= 1;
+        window.hits.push_back(now);
+    }
+    return true;
+}
+
+bool RateLimiter::IsThrottled() {
+    QMutexLocker locker(&mutex_);
+    // Waiting for a token is normal pacing, only report waits longer than that
+    int pacing = 0;
+    for (auto &window : windows_)
+        pacing = std::max(pacing, (window.period * 1000 + kThrottleMarginMsecs) / window.max_hits);
+    return WaitMsecs() > pacing;
+}
+
+void RateLimiter::SetWindows(const std::vector<Window> &windows) {
+    std::vector<Window> result;
+    for (auto window : windows) {
+        // Keep what we know about the windows that didn't change
+        for (auto &old : windows_) {
+            if (old.period == window.period && old.max_hits == window.max_hits) {
+                window.tokens = old.tokens;
+                window.last_refill = old.last_refill;
+                window.hits = old.hits;
+            }
+        }
+        result.push_back(window);
+    }
+    windows_ = result;
+}
+
+void RateLimiter::SyncState(int hits, int period, int restricted) {
+    qint64 now = Now();
+    for (auto &window : windows_) {
+        if (window.period != period)
+            continue;
+        Refill(&window, now);
+        // Other clients (or requests we didn't see complete yet) use the same budget.
+        // Assume the extra hits happened just now, which is the pessimistic choice.
+        while (static_cast<int>(window.hits.size()) < hits) {
+            window.hits.push_back(now);
+            window.tokens = std::min<double>(window.tokens, window.capacity - 1);
+        }
+    }
+    if (restricted > 0)
+        restricted_until_ = std::max(restricted_until_, now + restricted * 1000);
+}
+
+std::vector<std::vector<int>> RateLimiter::ParseTriples(const std::string &value) {
+    std::vector<std::vector<int>> result;
+    std::vector<std::string> entries;
+    boost::split(entries, value, boost::is_any_of(","));
+    for (auto &entry : entries) {
+        std::vector<std::string> parts;
+        boost::split(parts, entry, boost::is_any_of(":"));
+        if (parts.size() != 3)
+            continue;
+        std::vector<int> triple;
+        try {
+            for (auto &part : parts)
+                triple.push_back(std::stoi(part));
+        } catch (...) {
+            QLOG_WARN() << "Failed to parse rate limit entry:" << entry.c_str();
+            continue;
+        }
+        result.push_back(triple);
+    }
+    return result;
+}
+
+void RateLimiter::Update(QNetworkReply *reply) {
+    QMutexLocker locker(&mutex_);
+    std::string rules = reply->rawHeader("X-Rate-Limit-Rules").toStdString();
+    if (reply->hasRawHeader("X-Rate-Limit-Policy"))
+        policy_ = reply->rawHeader("X-Rate-Limit-Policy").toStdString();
+
+    if (!rules.empty()) {
+        std::vector<std::string> names;
+        boost::split(names, rules, boost::is_any_of(","));
+        std::vector<Window> windows;
+        std::vector<std::vector<int>> states;
+        for (auto name : names) {
+            boost::trim(name);
+            if (name.empty())
+                continue;
+            std::string header = "X-Rate-Limit-" + name;
+            for (auto &triple : ParseTriples(reply->rawHeader(header.c_str()).toStdString()))
+                windows.push_back(MakeWindow(triple[0], triple[1], triple[2]));
+            auto rule_states = ParseTriples(reply->rawHeader((header + "-State").c_str()).toStdString());
+            states.insert(states.end(), rule_states.begin(), rule_states.end());
+        }
+        if (!windows.empty()) {
+            bool changed = windows.size() != windows_.size();
+            for (size_t i = 0; !changed && i < windows.size(); ++i)
+                changed = windows[i].max_hits != windows_[i].max_hits || windows[i].period != windows_[i].period;
+            if (changed) {
+                std::string description;
+                for (auto &window : windows)
+                    description += std::to_string(window.max_hits) + "/" + std::to_string(window.period) + "s ";
+                QLOG_DEBUG() << "Rate limit policy" << policy_.c_str() << "changed:" << description.c_str();
+            }
+            SetWindows(windows);
+        }
+        for (auto &state : states)
+            SyncState(state[0], state[1], state[2]);
+    }
+
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 429) {
+        int retry_after = 0;
+        if (reply->hasRawHeader("Retry-After"))
+            retry_after = reply->rawHeader("Retry-After").toInt();
+        if (retry_after <= 0) {
+            for (auto &window : windows_)
+                retry_after = std::max(retry_after, window.penalty);
+            if (retry_after <= 0)
+                retry_after = kThrottleSleep;
+        }
+        QLOG_WARN() << "Rate limit exceeded, waiting" << retry_after << "seconds";
+        restricted_until_ = std::max(restricted_until_, Now() + retry_after * 1000);
+    }
+}
@@ -0,0 +1,109 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+class QNetworkReply;
+
+// Budget assumed until the server tells us otherwise: 45 requests per 60 seconds.
+// These values are approximated based on some quick testing.
+const int kThrottleRequests = 45;
+const int kThrottleSleep = 60;
+// Extra time added to every window so that network jitter doesn't push us over the limit
+const int kThrottleMarginMsecs = 1000;
+// How many requests of a window may be sent back-to-back before we start pacing them
+const int kThrottleBurstDivisor = 8;
+
+/*
+ * Token bucket rate limiter for API requests.
+ *
+ * The budget is learned from reply headers that look like this:
+ *
+ *   X-Rate-Limit-Policy: backend-request-limit
+ *   X-Rate-Limit-Rules: Account
+ *   X-Rate-Limit-Account: 45:60:60,240:240:900
+ *   X-Rate-Limit-Account-State: 1:60:0,1:240:0
+ *
+ * where each comma separated entry of a rule is "max hits:period:penalty" and the
+ * state is "current hits:period:active restriction", all periods in seconds.
+ * A 429 reply (optionally with Retry-After) restricts us until the penalty is over.
+ *
+ * Every window refills its bucket continuously at max_hits/period, so requests
+ * are spread over the whole window instead of being fired in one burst followed
+ * by a long sleep.  On top of that we keep the send time of recent requests so
+ * that no window ever sees more than max_hits.
+ *
+ * The budget belongs to the account, not to a league, so every worker of an account
+ * shares the limiter returned by ForAccount.  Workers live on their own threads,
+ * hence all public methods lock.
+ */
+class RateLimiter {
+public:
+    RateLimiter();
+    // The limiter shared by everyone talking to the API on behalf of this account.
+    // Endpoints that the server limits separately (e.g. character inventories) get
+    // their own lane.  It lives for as long as somebody holds on to it.
+    static std::shared_ptr<RateLimiter> ForAccount(const std::string &account, const std::string &lane = "stash");
+    // Returns true and accounts for a request if one can be sent right now.
+    bool TryAcquire();
+    // Milliseconds until TryAcquire can succeed, 0 if it can right now.
+    int MsecsUntilNextRequest();
+    // True if the server restricted us or the budget is exhausted for a while.
+    bool IsThrottled();
+    // Learns the budget and current state from the reply to a rate limited request.
+    void Update(QNetworkReply *reply);
+    std::string policy() const;
+    // Total time TryAcquire pretended to wait in virtual time mode
+    qint64 skipped_msecs() const;
+    // With virtual time the limiter never makes anyone wait, it moves its own clock
+    // forward instead.  Used to replay captured traffic as fast as possible.
+    static void SetVirtualTime(bool enabled);
+private:
+    struct Window {
+        int max_hits;
+        int period;
+        int penalty;
+        int capacity;
+        double tokens;
+        qint64 last_refill;
+        std::deque<qint64> hits;
+    };
+
+    qint64 Now() const;
+    int WaitMsecs();
+    void SetWindows(const std::vector<Window> &windows);
+    void Refill(Window *window, qint64 now);
+    void SyncState(int hits, int period, int restricted);
+    static Window MakeWindow(int max_hits, int period, int penalty);
+    static std::vector<std::vector<int>> ParseTriples(const std::string &value);
+
+    std::vector<Window> windows_;
+    std::string policy_;
+    qint64 restricted_until_{0};
+    qint64 skipped_{0};
+    QElapsedTimer clock_;
+    mutable QMutex mutex_;
+};
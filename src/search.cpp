@@ -19,6 +19,7 @@
 
 #include "search.h"
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <QTreeView>
@@ -31,12 +32,12 @@
 #include "QsLog.h"
 #include <QMessageBox>
 
-Search::Search(BuyoutManager &bo_manager, const std::string &caption,
+Search::Search(BuyoutManager &bo_manager, const ItemsManager &items_manager, const std::string &caption,
                const std::vector<std::unique_ptr<Filter>> &filters, QTreeView *view) :
     caption_(caption),
     view_(view),
     bo_manager_(bo_manager),
-    model_(std::make_unique<ItemsModel>(bo_manager, *this))
+    model_(std::make_unique<ItemsModel>(bo_manager, items_manager, *this))
 {
     using move_only = std::unique_ptr<Column>;
     move_only init[] = {
@@ -104,39 +105,44 @@ const std::unique_ptr<Bucket> &Search::bucket(int row) const {
     return active_buckets[row];
 }
 
-void Search::FilterItems(const Items &items) {
+void Search::FilterItems(const ItemStore &store) {
     // If we're just changing tabs we don't need to update anything
     if (refresh_reason_ == RefreshReason::TabChanged)
         return;
 
     QLOG_DEBUG() << "FilterItems: reason(" << refresh_reason_ << ")";
-    items_.clear();
-    for (const auto &item : items) {
-        bool matches = true;
-        for (auto &filter : filters_)
-            if (!filter->Matches(item)) {
-                matches = false;
-                break;
-            }
-        if (matches)
-            items_.push_back(item);
-    }
-
-    UpdateItemCounts(items);
+    // Every filter narrows down the rows left by the ones before it
+    std::vector<uint8_t> mask(store.size(), 1);
+    for (auto &filter : filters_)
+        filter->Select(store, &mask);
 
     // Single bucket with null location is used to view all items at once
     bucket_.clear();
     bucket_.push_back(std::make_unique<Bucket>(ItemLocation()));
 
-    std::map<ItemLocation, std::unique_ptr<Bucket>> bucketed_tabs;
-    for (const auto &item : items_) {
-        ItemLocation location = item->location();
-        if (!bucketed_tabs.count(location))
-            bucketed_tabs[location] = std::make_unique<Bucket>(location);
-        bucketed_tabs[location]->AddItem(item);        
+    // Buckets by location id of the store
+    std::vector<std::unique_ptr<Bucket>> tabs(store.locations().size());
+    auto &location_ids = store.location_ids();
+    items_.clear();
+    for (size_t row = 0; row < store.size(); ++row) {
+        if (!mask[row])
+            continue;
+        const std::shared_ptr<Item> &item = store.item(row);
+        items_.push_back(item);
+        std::unique_ptr<Bucket> &tab = tabs[location_ids[row]];
+        if (!tab)
+            tab = std::make_unique<Bucket>(store.locations()[location_ids[row]]);
+        tab->AddItem(item);
         bucket_.front()->AddItem(item);
     }
 
+    UpdateItemCounts(store.items());
+
+    std::map<ItemLocation, std::unique_ptr<Bucket>> bucketed_tabs;
+    for (auto &tab : tabs)
+        if (tab)
+            bucketed_tabs[tab->location()] = std::move(tab);
+
     // We need to add empty tabs here as there are no items to force their addition
     // But only do so if no filters are active as we want to hide empty tabs when
     // filtering
@@ -155,10 +161,116 @@ void Search::FilterItems(const Items &items) {
     model_->SetSorted(false);
 }
 
+bool Search::Matches(const std::shared_ptr<Item> &item) const {
+    for (auto &filter : filters_)
+        if (!filter->Matches(item))
+            return false;
+    return true;
+}
+
+void Search::UpdateLocation(const ItemLocation &location, const Items &location_items, const Items &all_items) {
+    auto same_location = [&location](const std::shared_ptr<Item> &item) {
+        return !(item->location() < location) && !(location < item->location());
+    };
+
+    for (auto &item : items_)
+        if (same_location(item))
+            filtered_item_count_total_ -= item->count();
+    items_.erase(std::remove_if(items_.begin(), items_.end(), same_location), items_.end());
+
+    auto bucket = std::make_unique<Bucket>(location);
+    for (auto &item : location_items) {
+        if (Matches(item)) {
+            items_.push_back(item);
+            bucket->AddItem(item);
+            filtered_item_count_total_ += item->count();
+        }
+    }
+    unfiltered_item_count_ = all_items.size();
+
+    bool sorted = model_->IsSorted();
+    if (sorted)
+        bucket->Sort(*columns_[model_->GetSortColumn()], model_->GetSortOrder());
+
+    // Same rules as FilterItems: empty stash tabs are only shown when nothing is filtered out
+    bool keep = !bucket->items().empty();
+    if (!keep && !IsAnyFilterActive()) {
+        for (auto &tab : bo_manager_.GetStashTabLocations())
+            if (!(tab < location) && !(location < tab))
+                keep = true;
+    }
+
+    bool by_tab = (current_mode_ == ByTab);
+    auto it = std::lower_bound(buckets_.begin(), buckets_.end(), location,
+        [](const std::unique_ptr<Bucket> &lhs, const ItemLocation &rhs) { return lhs->location() < rhs; });
+    int row = it - buckets_.begin();
+    bool exists = (it != buckets_.end()) && !(location < (*it)->location());
+
+    if (exists && keep) {
+        QModelIndex parent = by_tab ? model_->index(row) : QModelIndex();
+        ReplaceBucketItems(&*it, std::move(bucket), parent);
+        if (by_tab)
+            emit model_->dataChanged(parent, parent);
+    } else if (exists) {
+        if (by_tab)
+            model_->beginRemoveRows(QModelIndex(), row, row);
+        buckets_.erase(it);
+        if (by_tab)
+            model_->endRemoveRows();
+    } else if (keep) {
+        if (by_tab)
+            model_->beginInsertRows(QModelIndex(), row, row);
+        buckets_.insert(it, std::move(bucket));
+        if (by_tab)
+            model_->endInsertRows();
+    }
+
+    // The "all items" bucket has no per-location structure, rebuild it
+    if (!bucket_.empty()) {
+        auto all = std::make_unique<Bucket>(ItemLocation());
+        for (auto &item : items_)
+            all->AddItem(item);
+        if (sorted)
+            all->Sort(*columns_[model_->GetSortColumn()], model_->GetSortOrder());
+        ReplaceBucketItems(&bucket_.front(), std::move(all), by_tab ? QModelIndex() : model_->index(0));
+    }
+}
+
+void Search::ReplaceBucketItems(std::unique_ptr<Bucket> *bucket, std::unique_ptr<Bucket> replacement, const QModelIndex &parent) {
+    // Without a valid parent nobody is looking at this bucket so skip notifications
+    int old_count = (*bucket)->items().size();
+    int new_count = replacement->items().size();
+    if (parent.isValid() && old_count > 0) {
+        model_->beginRemoveRows(parent, 0, old_count - 1);
+        *bucket = std::make_unique<Bucket>(replacement->location());
+        model_->endRemoveRows();
+    }
+    if (parent.isValid() && new_count > 0)
+        model_->beginInsertRows(parent, 0, new_count - 1);
+    *bucket = std::move(replacement);
+    if (parent.isValid() && new_count > 0)
+        model_->endInsertRows();
+}
+
 QString Search::GetCaption() {
     return QString("%1 [%2]").arg(caption_.c_str()).arg(GetItemsCount());
 }
 
+void Search::UpdateLocationTitle(const ItemLocation &location) {
+    if (current_mode_ != ByTab || buckets_.empty())
+        return;
+    if (!location.IsValid()) {
+        emit model_->dataChanged(model_->index(0), model_->index(buckets_.size() - 1));
+        return;
+    }
+    auto it = std::lower_bound(buckets_.begin(), buckets_.end(), location,
+        [](const std::unique_ptr<Bucket> &lhs, const ItemLocation &rhs) { return lhs->location() < rhs; });
+    if (it != buckets_.end() && !(location < (*it)->location())) {
+        QModelIndex index = model_->index(it - buckets_.begin());
+        emit model_->dataChanged(index, index);
+    }
+}
+
 ItemLocation Search::GetTabLocation(const QModelIndex & index) const {
     if (!index.isValid())
         return ItemLocation();
@@ -194,9 +306,9 @@ int Search::GetItemsCount() {
     return filtered_item_count_total_;
 }
 
-void Search::Activate(const Items &items) {
+void Search::Activate(const ItemStore &store) {
     FromForm();
-    FilterItems(items);
+    FilterItems(store);
     view_->setSortingEnabled(false);
     view_->setModel(model_.get());
     view_->header()->setSortIndicator(model_->GetSortColumn(), model_->GetSortOrder());
@@ -26,11 +26,13 @@
 #include "item.h"
 #include "column.h"
 #include "bucket.h"
+#include "itemstore.h"
 #include "util.h"
 
 class BuyoutManager;
 class Filter;
 class FilterData;
+class ItemsManager;
 class ItemsModel;
 class QTreeView;
 class QModelIndex;
@@ -43,8 +45,13 @@ public:
     };
 
 public:
-    Search(BuyoutManager &bo, const std::string &caption, const std::vector<std::unique_ptr<Filter>> &filters, QTreeView *view);
-    void FilterItems(const Items &items);
+    Search(BuyoutManager &bo, const ItemsManager &items_manager, const std::string &caption,
+           const std::vector<std::unique_ptr<Filter>> &filters, QTreeView *view);
+    void FilterItems(const ItemStore &store);
+    // Replaces items of a single location, all_items is the complete item list after the change
+    void UpdateLocation(const ItemLocation &location, const Items &location_items, const Items &all_items);
+    // Repaints the title of a location, or of all of them if it's invalid
+    void UpdateLocationTitle(const ItemLocation &location);
     void FromForm();
     void ToForm();
     void ResetForm();
@@ -56,7 +63,7 @@ public:
     int GetItemsCount();
     bool IsAnyFilterActive() const;
     // Sets this search as current, will display items in passed QTreeView.
-    void Activate(const Items &items);
+    void Activate(const ItemStore &store);
     void RestoreViewProperties();
     void SaveViewProperties();
     ItemLocation GetTabLocation(const QModelIndex & index) const;
@@ -66,6 +73,8 @@ public:
     void SetRefreshReason(RefreshReason::Type reason) { refresh_reason_ = reason;};
 private:
     void UpdateItemCounts(const Items &items);
+    bool Matches(const std::shared_ptr<Item> &item) const;
+    void ReplaceBucketItems(std::unique_ptr<Bucket> *bucket, std::unique_ptr<Bucket> replacement, const QModelIndex &parent);
 
     std::vector<std::unique_ptr<FilterData>> filters_;
     std::vector<std::unique_ptr<Column>> columns_;
@@ -38,6 +38,7 @@ SqliteDataStore::SqliteDataStore(const std::string &filename) :
     }
     CreateTable("data", "key TEXT PRIMARY KEY, value BLOB");
     CreateTable("currency", "timestamp INTEGER PRIMARY KEY, value TEXT");
+    CreateTable("locations", "key TEXT PRIMARY KEY, items BLOB, fingerprint BLOB");
 }
 
 void SqliteDataStore::CreateTable(const std::string &name, const std::string &fields) {
@@ -48,18 +49,22 @@ void SqliteDataStore::CreateTable(const std::string &name, const std::string &fi
 }
 
 std::string SqliteDataStore::Get(const std::string &key, const std::string &default_value) {
+    QMutexLocker lock(&mutex_);
     std::string query = "SELECT value FROM data WHERE key = ?";
     sqlite3_stmt *stmt;
     sqlite3_prepare(db_, query.c_str(), -1, &stmt, 0);
     sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
     std::string result(default_value);
-    if (sqlite3_step(stmt) == SQLITE_ROW)
-        result = std::string(static_cast<const char*>(sqlite3_column_blob(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        int size = sqlite3_column_bytes(stmt, 0);
+        result = size > 0 ? std::string(static_cast<const char*>(sqlite3_column_blob(stmt, 0)), size) : std::string();
+    }
     sqlite3_finalize(stmt);
     return result;
 }
 
 void SqliteDataStore::Set(const std::string &key, const std::string &value) {
+    QMutexLocker lock(&mutex_);
     std::string query = "INSERT OR REPLACE INTO data (key, value) VALUES (?, ?)";
     sqlite3_stmt *stmt;
     sqlite3_prepare(db_, query.c_str(), -1, &stmt, 0);
@@ -70,6 +75,7 @@ void SqliteDataStore::Set(const std::string &key, const std::string &value) {
 }
 
 void SqliteDataStore::InsertCurrencyUpdate(const CurrencyUpdate &update) {
+    QMutexLocker lock(&mutex_);
     std::string query = "INSERT INTO currency (timestamp, value) VALUES (?, ?)";
     sqlite3_stmt *stmt;
     sqlite3_prepare(db_, query.c_str(), -1, &stmt, 0);
@@ -80,6 +86,7 @@ void SqliteDataStore::InsertCurrencyUpdate(const CurrencyUpdate &update) {
 }
 
 std::vector<CurrencyUpdate> SqliteDataStore::GetAllCurrency() {
+    QMutexLocker lock(&mutex_);
     std::string query = "SELECT timestamp, value FROM currency ORDER BY timestamp ASC";
     sqlite3_stmt* stmt;
     sqlite3_prepare(db_, query.c_str(), -1, &stmt, 0);
@@ -94,6 +101,51 @@ std::vector<CurrencyUpdate> SqliteDataStore::GetAllCurrency() {
     return result;
 }
 
+std::vector<StoredLocation> SqliteDataStore::GetLocations() {
+    QMutexLocker lock(&mutex_);
+    std::string query = "SELECT key, items, fingerprint FROM locations";
+    sqlite3_stmt *stmt;
+    sqlite3_prepare(db_, query.c_str(), -1, &stmt, 0);
+    std::vector<StoredLocation> result;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        StoredLocation location;
+        location.key = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        if (sqlite3_column_bytes(stmt, 1) > 0)
+            location.items.assign(static_cast<const char*>(sqlite3_column_blob(stmt, 1)), sqlite3_column_bytes(stmt, 1));
+        if (sqlite3_column_bytes(stmt, 2) > 0)
+            location.fingerprint.assign(static_cast<const char*>(sqlite3_column_blob(stmt, 2)), sqlite3_column_bytes(stmt, 2));
+        result.push_back(location);
+    }
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+bool SqliteDataStore::SetLocations(const std::vector<StoredLocation> &locations, const std::vector<std::string> &removed) {
+    QMutexLocker lock(&mutex_);
+    if (sqlite3_exec(db_, "BEGIN TRANSACTION", 0, 0, 0) != SQLITE_OK)
+        return false;
+    bool ok = true;
+    sqlite3_stmt *stmt;
+    sqlite3_prepare(db_, "INSERT OR REPLACE INTO locations (key, items, fingerprint) VALUES (?, ?, ?)", -1, &stmt, 0);
+    for (auto &location : locations) {
+        sqlite3_bind_text(stmt, 1, location.key.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_blob(stmt, 2, location.items.c_str(), location.items.size(), SQLITE_STATIC);
+        sqlite3_bind_blob(stmt, 3, location.fingerprint.c_str(), location.fingerprint.size(), SQLITE_STATIC);
+        ok = ok && sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_prepare(db_, "DELETE FROM locations WHERE key = ?", -1, &stmt, 0);
+    for (auto &key : removed) {
+        sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
+        ok = ok && sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db_, ok ? "COMMIT" : "ROLLBACK", 0, 0, 0);
+    return ok;
+}
+
 void SqliteDataStore::SetBool(const std::string &key, bool value) {
     SetInt(key, static_cast<int>(value));
 }
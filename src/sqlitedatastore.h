@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <QMutex>
 #include <string>
 #include <vector>
 
@@ -40,10 +41,15 @@ public:
     bool GetBool(const std::string &key, bool default_value = false);
     void SetInt(const std::string &key, int value);
     int GetInt(const std::string &key, int default_value = 0);
+    std::vector<StoredLocation> GetLocations();
+    bool SetLocations(const std::vector<StoredLocation> &locations, const std::vector<std::string> &removed);
     static std::string MakeFilename(const std::string &name, const std::string &league);
 private:
     void CreateTable(const std::string &name, const std::string &fields);
 
     std::string filename_;
     sqlite3 *db_;
+    // The connection is shared by the GUI and the items worker, every method holds this for as
+    // long as it uses db_ so that nothing ends up inside another thread's transaction
+    QMutex mutex_;
 };
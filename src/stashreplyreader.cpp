@@ -0,0 +1,235 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "stashreplyreader.h"
+
+#include "rapidjson/reader.h"
+
+#include "tabparser.h"
+#include "util.h"
+
+StashReplyReader::StashReplyReader(const QByteArray &bytes, const ItemLocation &location) :
+    bytes_(bytes),
+    stream_(bytes.constData()),
+    location_(location),
+    allocator_(buffer_, sizeof(buffer_)),
+    arena_(std::make_shared<ItemArena>())
+{
+    // Top level items are never socketed, so they all get the same location members
+    rapidjson::Document members;
+    members.SetObject();
+    location_.ToItemJson(&members, members.GetAllocator());
+    std::string text = Util::RapidjsonSerialize(members);
+    // "{...}" -> "...}"
+    suffix_ = QByteArray::fromStdString(text.substr(1));
+    members_suffix_ = "," + suffix_;
+}
+
+bool StashReplyReader::Read(ParsedReply *result) {
+    result->valid = ReadObject(result);
+    if (!result->valid || !result->error.empty()) {
+        // Whatever came with an error isn't the tab contents
+        result->items.clear();
+        result->has_tabs = false;
+    }
+    return result->valid;
+}
+
+bool StashReplyReader::ReadTabList(ParsedReply *result) {
+    skip_items_ = true;
+    return Read(result);
+}
+
+bool StashReplyReader::ReadObject(ParsedReply *result) {
+    rapidjson::SkipWhitespace(stream_);
+    if (stream_.Take() != '{')
+        return false;
+    rapidjson::SkipWhitespace(stream_);
+    if (stream_.Peek() == '}')
+        return true;
+
+    while (true) {
+        rapidjson::SkipWhitespace(stream_);
+        rapidjson::Document key;
+        key.ParseStream<rapidjson::kParseStopWhenDoneFlag>(stream_);
+        if (key.HasParseError() || !key.IsString())
+            return false;
+        rapidjson::SkipWhitespace(stream_);
+        if (stream_.Take() != ':')
+            return false;
+        rapidjson::SkipWhitespace(stream_);
+
+        std::string name = key.GetString();
+        if (name == "items" && stream_.Peek() == '[' && skip_items_) {
+            // Walked over without building anything
+            rapidjson::Reader reader;
+            rapidjson::BaseReaderHandler<> handler;
+            if (!reader.Parse<rapidjson::kParseStopWhenDoneFlag>(stream_, handler))
+                return false;
+        } else if (name == "items" && stream_.Peek() == '[') {
+            if (!ReadItems(&result->items))
+                return false;
+        } else if (name == "tabs" && stream_.Peek() == '[') {
+            if (!ReadTabs(result))
+                return false;
+        } else {
+            rapidjson::Document value;
+            value.ParseStream<rapidjson::kParseStopWhenDoneFlag>(stream_);
+            if (value.HasParseError())
+                return false;
+            if (name == "error")
+                result->error = Util::RapidjsonSerialize(value);
+        }
+
+        rapidjson::SkipWhitespace(stream_);
+        char next = stream_.Take();
+        if (next == '}')
+            return true;
+        if (next != ',')
+            return false;
+    }
+}
+
+bool StashReplyReader::ReadTabs(ParsedReply *result) {
+    size_t begin = stream_.Tell();
+    stream_.Take();
+    rapidjson::SkipWhitespace(stream_);
+    if (stream_.Peek() == ']') {
+        stream_.Take();
+        return true;
+    }
+
+    while (true) {
+        rapidjson::SkipWhitespace(stream_);
+        allocator_.Clear();
+        rapidjson::Document tab(&allocator_);
+        tab.ParseStream<rapidjson::kParseStopWhenDoneFlag>(stream_);
+        if (tab.HasParseError())
+            return false;
+        result->tab_hashes.push_back(TabParser::TabHash(tab));
+
+        rapidjson::SkipWhitespace(stream_);
+        char next = stream_.Take();
+        if (next == ']')
+            break;
+        if (next != ',')
+            return false;
+    }
+    result->has_tabs = true;
+    // Kept as text, it's only needed if the tab list turns out to be different
+    result->tabs = std::string(bytes_.constData() + begin, stream_.Tell() - begin);
+    return true;
+}
+
+bool StashReplyReader::ReadItems(Items *items) {
+    stream_.Take();
+    rapidjson::SkipWhitespace(stream_);
+    if (stream_.Peek() == ']') {
+        stream_.Take();
+        return true;
+    }
+
+    while (true) {
+        rapidjson::SkipWhitespace(stream_);
+        size_t begin = stream_.Tell();
+        // Everything the previous item allocated goes away, the buffer stays
+        allocator_.Clear();
+        rapidjson::Document item(&allocator_);
+        item.ParseStream<rapidjson::kParseStopWhenDoneFlag>(stream_);
+        if (item.HasParseError())
+            return false;
+
+        if (item.IsObject()) {
+            bool has_members = item.MemberCount() > 0;
+            ItemLocation location(location_);
+            location.FromItemJson(item);
+            location.ToItemJson(&item, allocator_);
+            items->push_back(std::make_shared<Item>(item, Slice(begin, stream_.Tell(), has_members), arena_));
+
+            location.set_socketed(true);
+            if (item.HasMember("socketedItems") && item["socketedItems"].IsArray())
+                TabParser::ParseItems(&item["socketedItems"], location, allocator_, items, arena_);
+        }
+
+        rapidjson::SkipWhitespace(stream_);
+        char next = stream_.Take();
+        if (next == ']')
+            return true;
+        if (next != ',')
+            return false;
+    }
+}
+
+bool StashReplyReader::ReadStored(Items *items) {
+    rapidjson::SkipWhitespace(stream_);
+    if (stream_.Take() != '[')
+        return false;
+    rapidjson::SkipWhitespace(stream_);
+    if (stream_.Peek() == ']')
+        return true;
+
+    while (true) {
+        if (!ReadStoredItem(items))
+            return false;
+        rapidjson::SkipWhitespace(stream_);
+        char next = stream_.Take();
+        if (next == ']')
+            return true;
+        if (next != ',')
+            return false;
+    }
+}
+
+bool StashReplyReader::ReadStored(Items *items, int begin, int end) {
+    if (begin < 0 || begin > end || end > bytes_.size())
+        return false;
+    // Positions are relative to begin from here on
+    stream_ = rapidjson::StringStream(bytes_.constData() + begin);
+    int length = end - begin;
+    while (static_cast<int>(stream_.Tell()) < length) {
+        if (!ReadStoredItem(items, begin))
+            return false;
+        rapidjson::SkipWhitespace(stream_);
+        if (static_cast<int>(stream_.Tell()) >= length)
+            break;
+        if (stream_.Take() != ',')
+            return false;
+        rapidjson::SkipWhitespace(stream_);
+    }
+    return static_cast<int>(stream_.Tell()) <= length;
+}
+
+bool StashReplyReader::ReadStoredItem(Items *items, int base) {
+    rapidjson::SkipWhitespace(stream_);
+    size_t begin = stream_.Tell();
+    allocator_.Clear();
+    rapidjson::Document item(&allocator_);
+    item.ParseStream<rapidjson::kParseStopWhenDoneFlag>(stream_);
+    if (item.HasParseError())
+        return false;
+    if (item.IsObject())
+        items->push_back(std::make_shared<Item>(item, ItemJson(bytes_, base + static_cast<int>(begin), static_cast<int>(stream_.Tell() - begin)), arena_));
+    return true;
+}
+
+ItemJson StashReplyReader::Slice(size_t begin, size_t end, bool has_members) {
+    // "{..." of the reply, then ",<location members>}" or "<location members>}"
+    return ItemJson(bytes_, static_cast<int>(begin), static_cast<int>(end - begin - 1), has_members ? members_suffix_ : suffix_);
+}
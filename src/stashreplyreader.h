@@ -0,0 +1,77 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <memory>
+#include <string>
+
+#include "item.h"
+#include "itemlocation.h"
+#include "rapidjson_util.h"
+
+struct ParsedReply;
+
+/*
+ * Reads a get-stash-items or get-items reply in a single pass.
+ *
+ * Instead of building a DOM of the whole reply (several times the size of the
+ * reply itself for a big tab) the top level object is walked by hand and only
+ * one item at a time is turned into a small DOM, in a reused buffer.  The text
+ * of every item is a slice of the reply followed by the location members (see
+ * ItemJson), so Item doesn't have to serialize or even copy it.
+ *
+ * Socketed items are rare enough to go through the regular path.  All items
+ * of a reader share one ItemArena, so a reply's items are freed in a few blocks.
+ */
+class StashReplyReader {
+public:
+    StashReplyReader(const QByteArray &bytes, const ItemLocation &location);
+    // Fills in result, false if the reply is not a well formed JSON object
+    bool Read(ParsedReply *result);
+    // Same without building any items, to get at the tab list
+    bool ReadTabList(ParsedReply *result);
+    // Reads the array of items ItemsManagerWorker keeps in the data store instead.  Those
+    // already carry their location and socketed items are listed on their own.
+    bool ReadStored(Items *items);
+    // Same for the comma separated items between offsets begin and end of that array
+    bool ReadStored(Items *items, int begin, int end);
+private:
+    // Reads one stored item at the current position, stream_ starting at offset base of bytes_
+    bool ReadStoredItem(Items *items, int base = 0);
+
+    bool ReadObject(ParsedReply *result);
+    bool ReadTabs(ParsedReply *result);
+    bool ReadItems(Items *items);
+    ItemJson Slice(size_t begin, size_t end, bool has_members);
+
+    const QByteArray &bytes_;
+    rapidjson::StringStream stream_;
+    ItemLocation location_;
+    // What closes the text of a top level item: its location members and the brace,
+    // same for every item of a reply.  The second one is for items with other members.
+    QByteArray suffix_, members_suffix_;
+    bool skip_items_{false};
+    char buffer_[16 * 1024];
+    rapidjson_allocator allocator_;
+    // for the containers of every item read
+    std::shared_ptr<ItemArena> arena_;
+};
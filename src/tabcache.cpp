@@ -1,8 +1,22 @@
 #include "tabcache.h"
 #include "QsLog.h"
 
-#include <QDir>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSaveFile>
+#include <QTimer>
+#include <algorithm>
+#include <vector>
+#include "rapidjson/document.h"
+
+#include "util.h"
 
 // TabCache
 //
@@ -33,8 +47,8 @@
 // really disables caching.
 //
 // So the plan is to basically just to ignore the Cache-Control and Pragma headers.
-// This is achieved by overridding QNetworkDiskCache 'prepare' method so it
-// effectively doesn't seem them.
+// This is achieved in our 'prepare' method so the rest of the cache effectively
+// doesn't see them.
 //
 // A helper method is needed however to create our network requests properly such
 // such that the requests always prefer hitting in the cache.
@@ -43,40 +57,107 @@
 //
 // Request(url, <flags>);
 //
-// Where <flags> can be used to force an eviction, causing a reload
+// Where <flags> can be used to force a reload
 //   Request(url, TabCache::Refresh);
 //
 // If 'Refresh' is not specified we're guaranteed to hit in cache if entry exists
-// and fetch otherwise.
+// and fetch otherwise.  A refresh leaves the cached entry alone until the new reply
+// replaces it, so whatever was shown from it stays valid while we revalidate.
 //
 // So, to minimize overall API requests it will become a matter of minimizing requests
 // that ask for a refresh.  From the point of view of the rest of the application it will
 // always appear as if we request all the tabs.
+//
+// Storage
+//
+// Replies are stored compressed under the SHA-1 of their body in the object
+// directory, which is shared by the caches of all accounts and leagues so a tab
+// that looks the same everywhere is stored once.  Each cache keeps a small index
+// file mapping URLs to object hashes, the reply metadata and when the entry was
+// last used.  Entries unused for kCacheExpireInDays are dropped when the index is
+// loaded, and objects that no index refers to anymore are deleted at that point.
+
+// Index file of every cache, CollectGarbage looks for these
+const char *kIndexFileName = "tabcache.index";
+const quint32 kIndexMagic = 0x41515443; // "AQTC"
+const quint32 kIndexVersion = 1;
+// Objects younger than this are never collected, another cache may be about to refer to them
+const qint64 kGarbageGraceMsecs = 60 * 60 * 1000;
+// How long changes to the index may stay unsaved
+const int kIndexSaveDelayMsecs = 1000;
+// Written by Dump unless told otherwise
+const char *kStatsFileName = "tabcache.stats.json";
+// Upper bounds of the "idle" histogram in ToJson, in hours
+const int kIdleBucketHours[] = { 1, 6, 24, 72, 168 };
 
 TabCache::TabCache(QObject* parent)
-    :QNetworkDiskCache(parent)
+    :QAbstractNetworkCache(parent)
 {
 }
 
+TabCache::~TabCache() {
+    SaveIndex();
+    qDeleteAll(pending_.keys());
+}
+
+void TabCache::setCacheDirectory(const QString &directory) {
+    QMutexLocker locker(&mutex_);
+    directory_ = directory;
+    if (object_directory_.isEmpty())
+        object_directory_ = directory + "/objects";
+    QDir().mkpath(directory_);
+    QDir().mkpath(object_directory_);
+    RemoveLegacyCache();
+    LoadIndex();
+    CollectGarbage();
+}
+
+void TabCache::SetObjectDirectory(const QString &directory) {
+    QMutexLocker locker(&mutex_);
+    object_directory_ = directory;
+    QDir().mkpath(object_directory_);
+}
+
+void TabCache::setMaximumCacheSize(qint64 size) {
+    QMutexLocker locker(&mutex_);
+    maximum_size_ = size;
+    Shrink();
+}
+
+qint64 TabCache::cacheSize() const {
+    QMutexLocker locker(&mutex_);
+    return index_size_;
+}
+
+QString TabCache::IndexPath() const {
+    return directory_ + "/" + kIndexFileName;
+}
+
+QString TabCache::ObjectPath(const QByteArray &hash) const {
+    return object_directory_ + "/" + QString::fromLatin1(hash);
+}
+
 QNetworkRequest TabCache::Request(const QUrl &url, Flags flags) {
     QNetworkRequest request{url};
-    bool evicted = false;
-
-    if (flags.testFlag(Refresh)) {
-        remove(url);
-        evicted = true;
-    }
+    bool refresh = flags.testFlag(Refresh);
 
-    // At this point we've evicted any request that should be refreshed, so we always
-    // tell the 'real' request to prefer but not require the entry be in the cache.
+    // Unless a refresh is asked for, prefer but don't require the entry to be in the cache.
     // If it is not in the cache it will be fetched from the network regardless.
-    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, QNetworkRequest::PreferCache);
-    QLOG_DEBUG() << "Evicted:" << evicted << ":" << url.toDisplayString();
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
+                         refresh ? QNetworkRequest::AlwaysNetwork : QNetworkRequest::PreferCache);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, true);
+    QLOG_DEBUG() << "Refresh:" << refresh << ":" << url.toDisplayString();
 
     return request;
 }
 
+bool TabCache::Serves(const QNetworkRequest &request) {
+    int control = request.attribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferNetwork).toInt();
+    return control != QNetworkRequest::AlwaysNetwork && metaData(request.url()).isValid();
+}
+
 QIODevice *TabCache::prepare(const QNetworkCacheMetaData &metaData) {
+    QMutexLocker locker(&mutex_);
     QNetworkCacheMetaData local{metaData};
 
     //Default policy based on received HTTP headers is to not save to disk.
@@ -105,6 +186,433 @@ QIODevice *TabCache::prepare(const QNetworkCacheMetaData &metaData) {
     }
     local.setRawHeaders(headers);
 
-    return QNetworkDiskCache::prepare(local);
+    // QNetworkAccessManager writes the reply into the buffer and hands it back to insert(),
+    // or to remove() if the reply is abandoned
+    QBuffer *buffer = new QBuffer;
+    buffer->open(QBuffer::ReadWrite);
+    pending_[buffer] = local;
+    return buffer;
+}
+
+void TabCache::insert(QIODevice *device) {
+    QMutexLocker locker(&mutex_);
+    auto it = pending_.find(device);
+    if (it == pending_.end())
+        return;
+    QNetworkCacheMetaData meta = it.value();
+    pending_.erase(it);
+    QByteArray payload = static_cast<QBuffer*>(device)->data();
+    delete device;
+    if (directory_.isEmpty())
+        return;
+
+    QByteArray hash = QCryptographicHash::hash(payload, QCryptographicHash::Sha1).toHex();
+    QString path = ObjectPath(hash);
+    qint64 size;
+    if (QFile::exists(path)) {
+        // Same body as something we or another cache already have
+        size = QFileInfo(path).size();
+    } else {
+        QSaveFile file(path);
+        QByteArray compressed = qCompress(payload);
+        if (!file.open(QIODevice::WriteOnly) || file.write(compressed) != compressed.size() || !file.commit()) {
+            QLOG_WARN() << "Failed to write cache object" << path;
+            return;
+        }
+        size = compressed.size();
+        objects_size_ += size;
+    }
+
+    auto old = index_.find(meta.url());
+    if (old != index_.end())
+        index_size_ -= old->size;
+    index_[meta.url()] = { meta, hash, size, QDateTime::currentMSecsSinceEpoch() };
+    index_size_ += size;
+    Remember(meta, payload);
+    Shrink();
+    ScheduleSave();
+    // Whatever QNetworkAccessManager stores came from the network
+    ++misses_;
+    ++refresh_misses_;
+}
+
+QNetworkCacheMetaData TabCache::metaData(const QUrl &url) {
+    QMutexLocker locker(&mutex_);
+    auto it = memory_.find(url);
+    if (it != memory_.end())
+        return it->meta;
+    auto entry = index_.find(url);
+    if (entry != index_.end())
+        return entry->meta;
+    return QNetworkCacheMetaData();
+}
+
+void TabCache::updateMetaData(const QNetworkCacheMetaData &metaData) {
+    QMutexLocker locker(&mutex_);
+    auto it = memory_.find(metaData.url());
+    if (it != memory_.end())
+        it->meta = metaData;
+    auto entry = index_.find(metaData.url());
+    if (entry != index_.end()) {
+        entry->meta = metaData;
+        ScheduleSave();
+    }
+}
+
+QIODevice *TabCache::data(const QUrl &url) {
+    QMutexLocker locker(&mutex_);
+    auto entry = index_.find(url);
+    if (entry == index_.end())
+        return nullptr;
+
+    QByteArray payload;
+    auto it = memory_.find(url);
+    if (it != memory_.end()) {
+        ++memory_hits_;
+        lru_.splice(lru_.begin(), lru_, it->position);
+        payload = it->payload;
+    } else {
+        QFile file(ObjectPath(entry->hash));
+        if (!file.open(QIODevice::ReadOnly)) {
+            // Collected as garbage or deleted by hand, this is a plain miss then
+            QLOG_WARN() << "Cache object for" << url.toDisplayString() << "is gone";
+            remove(url);
+            return nullptr;
+        }
+        ++memory_misses_;
+        payload = qUncompress(file.readAll());
+        Remember(entry->meta, payload);
+    }
+    entry->last_used = QDateTime::currentMSecsSinceEpoch();
+    ScheduleSave();
+    ++hits_;
+    ++refresh_hits_;
+    bytes_served_ += payload.size();
+
+    // The caller owns the device, hand out a copy so the entry can be evicted any time
+    QBuffer *buffer = new QBuffer;
+    buffer->setData(payload);
+    buffer->open(QBuffer::ReadOnly);
+    return buffer;
+}
+
+bool TabCache::remove(const QUrl &url) {
+    QMutexLocker locker(&mutex_);
+    Forget(url);
+    // Also how QNetworkAccessManager abandons a reply it was writing
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        if (it.value().url() == url) {
+            delete it.key();
+            it = pending_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    auto entry = index_.find(url);
+    if (entry == index_.end())
+        return false;
+    // The object may be shared, it's left to CollectGarbage
+    index_size_ -= entry->size;
+    index_.erase(entry);
+    ScheduleSave();
+    return true;
+}
+
+void TabCache::clear() {
+    QMutexLocker locker(&mutex_);
+    lru_.clear();
+    memory_.clear();
+    memory_size_ = 0;
+    index_.clear();
+    index_size_ = 0;
+    dirty_ = true;
+    SaveIndex();
+    CollectGarbage();
+}
+
+void TabCache::Shrink() {
+    if (index_size_ <= maximum_size_)
+        return;
+    std::vector<std::pair<qint64, QUrl>> entries;
+    for (auto it = index_.begin(); it != index_.end(); ++it)
+        entries.push_back(std::make_pair(it->last_used, it.key()));
+    std::sort(entries.begin(), entries.end());
+    for (auto &entry : entries) {
+        if (index_size_ <= maximum_size_)
+            break;
+        remove(entry.second);
+    }
+}
+
+void TabCache::ScheduleSave() {
+    dirty_ = true;
+    if (save_scheduled_)
+        return;
+    save_scheduled_ = true;
+    QTimer::singleShot(kIndexSaveDelayMsecs, this, SLOT(SaveIndex()));
+}
+
+void TabCache::SaveIndex() {
+    QMutexLocker locker(&mutex_);
+    save_scheduled_ = false;
+    if (!dirty_ || directory_.isEmpty())
+        return;
+    QSaveFile file(IndexPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        QLOG_WARN() << "Failed to save cache index" << IndexPath();
+        return;
+    }
+    QDataStream stream(&file);
+    stream << kIndexMagic << kIndexVersion << static_cast<quint32>(index_.size());
+    for (auto &entry : index_)
+        stream << entry.meta << entry.hash << entry.size << entry.last_used;
+    if (file.commit())
+        dirty_ = false;
+}
+
+void TabCache::LoadIndex() {
+    index_.clear();
+    index_size_ = 0;
+    QFile file(IndexPath());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    QDataStream stream(&file);
+    quint32 magic, version, count;
+    stream >> magic >> version >> count;
+    if (magic != kIndexMagic || version != kIndexVersion) {
+        QLOG_WARN() << "Ignoring cache index" << IndexPath() << "of an unknown format";
+        return;
+    }
+    qint64 expired_before = QDateTime::currentDateTime().addDays(-kCacheExpireInDays).toMSecsSinceEpoch();
+    int expired = 0;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        IndexEntry entry;
+        stream >> entry.meta >> entry.hash >> entry.size >> entry.last_used;
+        if (stream.status() != QDataStream::Ok)
+            break;
+        if (entry.last_used < expired_before) {
+            ++expired;
+            continue;
+        }
+        index_[entry.meta.url()] = entry;
+        index_size_ += entry.size;
+    }
+    if (expired > 0) {
+        QLOG_DEBUG() << "Dropped" << expired << "cache entries that were not used for" << kCacheExpireInDays << "days";
+        dirty_ = true;
+        SaveIndex();
+    }
+}
+
+void TabCache::CollectGarbage() {
+    std::set<QByteArray> live;
+    // Can't tell what's in use otherwise, better keep everything
+    bool known = LiveObjects(&live);
+
+    QDateTime young = QDateTime::currentDateTime().addMSecs(-kGarbageGraceMsecs);
+    int collected = 0;
+    objects_size_ = 0;
+    for (auto &info : QDir(object_directory_).entryInfoList(QDir::Files)) {
+        if (known && !live.count(info.fileName().toLatin1()) && info.lastModified() <= young
+                && QFile::remove(info.absoluteFilePath())) {
+            ++collected;
+            continue;
+        }
+        objects_size_ += info.size();
+    }
+    if (collected > 0)
+        QLOG_DEBUG() << "Deleted" << collected << "cache objects nothing refers to anymore";
+}
+
+bool TabCache::LiveObjects(std::set<QByteArray> *live) const {
+    // Every cache sharing the object directory keeps its index somewhere below its parent
+    QDirIterator indexes(QFileInfo(object_directory_).absolutePath(), QStringList() << kIndexFileName,
+                         QDir::Files, QDirIterator::Subdirectories);
+    while (indexes.hasNext()) {
+        QString path = indexes.next();
+        if (path == QFileInfo(IndexPath()).absoluteFilePath())
+            continue;
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+        QDataStream stream(&file);
+        quint32 magic, version, count;
+        stream >> magic >> version >> count;
+        if (magic != kIndexMagic || version != kIndexVersion)
+            continue;
+        for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+            IndexEntry entry;
+            stream >> entry.meta >> entry.hash >> entry.size >> entry.last_used;
+            live->insert(entry.hash);
+        }
+        if (stream.status() != QDataStream::Ok)
+            return false;
+    }
+    // Our own index may not be on disk yet
+    for (auto &entry : index_)
+        live->insert(entry.hash);
+    return true;
+}
+
+void TabCache::RemoveLegacyCache() {
+    // QNetworkDiskCache kept raw replies in "data<version>" and "prepared" directories
+    bool removed = false;
+    for (auto &name : QDir(directory_).entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (name == "prepared" || QRegExp("data\\d+").exactMatch(name)) {
+            QDir(directory_ + "/" + name).removeRecursively();
+            removed = true;
+        }
+    }
+    if (removed)
+        QLOG_INFO() << "Removed the old format tab cache in" << directory_;
+}
+
+TabCacheStats TabCache::Stats() const {
+    QMutexLocker locker(&mutex_);
+    TabCacheStats stats;
+    stats.entries = index_.size();
+    stats.size = index_size_;
+    stats.maximum_size = maximum_size_;
+    stats.objects_size = objects_size_;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.bytes_served = bytes_served_;
+    stats.refresh_hits = refresh_hits_;
+    stats.refresh_misses = refresh_misses_;
+    stats.memory_size = memory_size_;
+    stats.memory_limit = memory_limit_;
+    stats.memory_hits = memory_hits_;
+    stats.memory_misses = memory_misses_;
+    stats.memory_evictions = memory_evictions_;
+    return stats;
+}
+
+std::vector<TabCacheEntry> TabCache::Snapshot() const {
+    QMutexLocker locker(&mutex_);
+    std::vector<TabCacheEntry> entries;
+    for (auto it = index_.begin(); it != index_.end(); ++it)
+        entries.push_back({ it.key(), it->hash, it->size, it->last_used });
+    // Most recently used first, the order Shrink gives up on them in reverse
+    std::sort(entries.begin(), entries.end(), [](const TabCacheEntry &lhs, const TabCacheEntry &rhs) {
+        return lhs.last_used > rhs.last_used;
+    });
+    return entries;
+}
+
+void TabCache::StartRefresh() {
+    QMutexLocker locker(&mutex_);
+    refresh_hits_ = refresh_misses_ = 0;
+}
+
+QByteArray TabCache::ToJson() const {
+    QMutexLocker locker(&mutex_);
+    TabCacheStats stats = Stats();
+    std::vector<TabCacheEntry> entries = Snapshot();
+
+    rapidjson::Document doc;
+    doc.SetObject();
+    auto &alloc = doc.GetAllocator();
+    // qint64 is neither of rapidjson's 64-bit types everywhere
+    auto add = [&alloc](rapidjson::Value *object, const char *name, qint64 value) {
+        object->AddMember(rapidjson::StringRef(name), static_cast<int64_t>(value), alloc);
+    };
+    rapidjson::Value directory(cacheDirectory().toStdString().c_str(), alloc);
+    doc.AddMember("directory", directory, alloc);
+    add(&doc, "entries", stats.entries);
+    add(&doc, "size", stats.size);
+    add(&doc, "maximum_size", stats.maximum_size);
+    add(&doc, "objects_size", stats.objects_size);
+    add(&doc, "hits", stats.hits);
+    add(&doc, "misses", stats.misses);
+    add(&doc, "bytes_served", stats.bytes_served);
+    add(&doc, "refresh_hits", stats.refresh_hits);
+    add(&doc, "refresh_misses", stats.refresh_misses);
+    add(&doc, "memory_size", stats.memory_size);
+    add(&doc, "memory_limit", stats.memory_limit);
+    add(&doc, "memory_hits", stats.memory_hits);
+    add(&doc, "memory_misses", stats.memory_misses);
+    add(&doc, "memory_evictions", stats.memory_evictions);
+
+    // How many entries weren't used for up to that many hours, the last bucket has the rest
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const size_t buckets = sizeof(kIdleBucketHours) / sizeof(kIdleBucketHours[0]);
+    std::vector<int> idle(buckets + 1, 0);
+    for (auto &entry : entries) {
+        size_t bucket = 0;
+        while (bucket < buckets && now - entry.last_used > kIdleBucketHours[bucket] * 3600 * 1000LL)
+            ++bucket;
+        ++idle[bucket];
+    }
+    rapidjson::Value histogram(rapidjson::kArrayType);
+    for (size_t i = 0; i <= buckets; ++i) {
+        rapidjson::Value bucket(rapidjson::kObjectType);
+        if (i < buckets)
+            bucket.AddMember("hours", kIdleBucketHours[i], alloc);
+        bucket.AddMember("entries", idle[i], alloc);
+        histogram.PushBack(bucket, alloc);
+    }
+    doc.AddMember("idle", histogram, alloc);
+
+    rapidjson::Value list(rapidjson::kArrayType);
+    for (auto &entry : entries) {
+        rapidjson::Value item(rapidjson::kObjectType);
+        rapidjson::Value url(entry.url.toString().toStdString().c_str(), alloc);
+        rapidjson::Value hash(entry.hash.constData(), alloc);
+        item.AddMember("url", url, alloc);
+        item.AddMember("hash", hash, alloc);
+        add(&item, "size", entry.size);
+        add(&item, "last_used", entry.last_used);
+        list.PushBack(item, alloc);
+    }
+    doc.AddMember("contents", list, alloc);
+
+    return QByteArray::fromStdString(Util::RapidjsonSerialize(doc));
+}
+
+bool TabCache::Dump(const QString &path) const {
+    QString target = path.isEmpty() ? cacheDirectory() + "/" + kStatsFileName : path;
+    QSaveFile file(target);
+    QByteArray json = ToJson();
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        QLOG_WARN() << "Failed to write cache statistics to" << target;
+        return false;
+    }
+    return true;
+}
+
+// The memory tier keeps the payload next to its metadata, keyed by URL.  Entries are
+// moved to the front of lru_ whenever they're used and dropped from the back once
+// memory_limit_ is exceeded; the disk still has them at that point.
+
+void TabCache::SetMemoryLimit(qint64 bytes) {
+    QMutexLocker locker(&mutex_);
+    memory_limit_ = bytes;
+    Evict();
+}
+
+void TabCache::Remember(const QNetworkCacheMetaData &meta, const QByteArray &payload) {
+    Forget(meta.url());
+    if (payload.size() > memory_limit_)
+        return;
+    lru_.push_front(meta.url());
+    memory_[meta.url()] = { meta, payload, lru_.begin() };
+    memory_size_ += payload.size();
+    Evict();
+}
+
+void TabCache::Forget(const QUrl &url) {
+    auto it = memory_.find(url);
+    if (it == memory_.end())
+        return;
+    memory_size_ -= it->payload.size();
+    lru_.erase(it->position);
+    memory_.erase(it);
+}
+
+void TabCache::Evict() {
+    while (memory_size_ > memory_limit_ && !lru_.empty()) {
+        Forget(lru_.back());
+        ++memory_evictions_;
+    }
 }
 
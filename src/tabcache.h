@@ -2,11 +2,40 @@
 
 #include <QObject>
 #include <QAbstractNetworkCache>
-#include <QNetworkDiskCache>
+#include <QNetworkCacheMetaData>
 #include <QIODevice>
+#include <QHash>
+#include <QMutex>
+#include <QUrl>
+#include <list>
 #include <set>
+#include <vector>
 
-class TabCache : public QNetworkDiskCache
+// Budget of the in-memory tier, enough for a few hundred typical stash tabs
+const qint64 kMemoryCacheSize = 64 * 1024 * 1024;
+
+struct TabCacheStats {
+    int entries{0};
+    // compressed bytes referenced by the cache and what they'd be uncompressed
+    qint64 size{0}, maximum_size{0};
+    // bytes of every object in the shared object directory, all accounts and leagues together.
+    // Counted when garbage is collected and kept up to date with our own writes since.
+    qint64 objects_size{0};
+    // replies served from the cache and fetched from the network, and the bytes that were not downloaded
+    qint64 hits{0}, misses{0}, bytes_served{0};
+    // same since the last StartRefresh
+    qint64 refresh_hits{0}, refresh_misses{0};
+    qint64 memory_size{0}, memory_limit{0}, memory_hits{0}, memory_misses{0}, memory_evictions{0};
+};
+
+struct TabCacheEntry {
+    QUrl url;
+    QByteArray hash;
+    qint64 size;
+    qint64 last_used;
+};
+
+class TabCache : public QAbstractNetworkCache
 {
     Q_OBJECT
 
@@ -20,15 +49,111 @@ public:
 public:
     TabCache(QObject * parent = 0);
 
-    ~TabCache() {};
+    ~TabCache();
 
     QNetworkRequest Request(const QUrl & url, Flags flags = None);
+    // True if the request is going to be answered from the cache without asking the server
+    bool Serves(const QNetworkRequest &request);
+
+    // Where the index of this cache lives, usually one per account and league
+    void setCacheDirectory(const QString &directory);
+    QString cacheDirectory() const { return directory_; }
+    // Where compressed payloads are stored by content hash.  Caches sharing it store
+    // identical replies once.  Defaults to "objects" inside the cache directory.
+    void SetObjectDirectory(const QString &directory);
+    void setMaximumCacheSize(qint64 size);
+    qint64 maximumCacheSize() const { return maximum_size_; }
 
+    QNetworkCacheMetaData metaData(const QUrl &url);
+    void updateMetaData(const QNetworkCacheMetaData &metaData);
+    QIODevice *data(const QUrl &url);
+    bool remove(const QUrl &url);
+    // Compressed bytes referenced by this cache
+    qint64 cacheSize() const;
     QIODevice *prepare(const QNetworkCacheMetaData &metaData);
+    void insert(QIODevice *device);
+
+    // Counters and contents for diagnostics.  Unlike the rest these can be called from
+    // any thread while the cache is in use.
+    TabCacheStats Stats() const;
+    std::vector<TabCacheEntry> Snapshot() const;
+    // Stats, entries by how long they weren't used and the entries themselves
+    QByteArray ToJson() const;
+    // Writes ToJson to path, or next to the index if it's empty
+    bool Dump(const QString &path = QString()) const;
+    // Starts counting refresh_hits and refresh_misses from zero
+    void StartRefresh();
+
+    // Recently used replies are kept in memory in front of the disk.  Everything
+    // is still written through to disk, the memory tier only saves reading it back.
+    void SetMemoryLimit(qint64 bytes);
+    qint64 memory_size() const { return memory_size_; }
+    // Replies served from memory, read from disk and dropped from memory to make room
+    qint64 memory_hits() const { return memory_hits_; }
+    qint64 memory_misses() const { return memory_misses_; }
+    qint64 memory_evictions() const { return memory_evictions_; }
+
+public slots:
+    void clear();
+    // Writes the index if anything changed, happens shortly after every change anyway
+    void SaveIndex();
 
 private:
+    struct MemoryEntry {
+        QNetworkCacheMetaData meta;
+        QByteArray payload;
+        std::list<QUrl>::iterator position;
+    };
+    struct IndexEntry {
+        QNetworkCacheMetaData meta;
+        // hex SHA-1 of the uncompressed payload, also the object's file name
+        QByteArray hash;
+        // compressed size on disk
+        qint64 size;
+        // msecs since epoch, entries not used for kCacheExpireInDays are dropped
+        qint64 last_used;
+    };
+
+    void Remember(const QNetworkCacheMetaData &meta, const QByteArray &payload);
+    void Forget(const QUrl &url);
+    void Evict();
+
+    QString IndexPath() const;
+    QString ObjectPath(const QByteArray &hash) const;
+    void LoadIndex();
+    void ScheduleSave();
+    // Drops least recently used entries until the cache fits maximum_size_
+    void Shrink();
+    // Deletes objects that no index under the object directory's parent refers to and counts the rest
+    void CollectGarbage();
+    // Hashes of objects referred to by any index under the object directory's parent,
+    // false if some index couldn't be read
+    bool LiveObjects(std::set<QByteArray> *live) const;
+    void RemoveLegacyCache();
+
     const int kCacheExpireInDays{7};
+    // Every public method locks this, diagnostics come from other threads
+    mutable QMutex mutex_{QMutex::Recursive};
+    QString directory_;
+    QString object_directory_;
+    qint64 maximum_size_{50 * 1024 * 1024};
+    QHash<QUrl, IndexEntry> index_;
+    qint64 index_size_{0};
+    // see TabCacheStats::objects_size
+    qint64 objects_size_{0};
+    bool dirty_{false};
+    bool save_scheduled_{false};
+
+    // most recently used first
+    std::list<QUrl> lru_;
+    QHash<QUrl, MemoryEntry> memory_;
+    // metadata of replies that are being written, by the buffer prepare() handed out
+    QHash<QIODevice*, QNetworkCacheMetaData> pending_;
+    qint64 memory_limit_{kMemoryCacheSize};
+    qint64 memory_size_{0};
+    qint64 memory_hits_{0}, memory_misses_{0}, memory_evictions_{0};
+    qint64 hits_{0}, misses_{0}, bytes_served_{0};
+    qint64 refresh_hits_{0}, refresh_misses_{0};
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(TabCache::Flags)
-
@@ -0,0 +1,229 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tabparser.h"
+
+#include <QCryptographicHash>
+#include <QRunnable>
+#include <QThread>
+#include <algorithm>
+#include "QsLog.h"
+#include "rapidjson/document.h"
+
+#include "stashreplyreader.h"
+#include "util.h"
+
+// How many parses per pool thread may be waiting before we signal back pressure
+const int kParseQueueDepth = 2;
+
+static std::string TabName(const rapidjson::Value &tab) {
+    return (tab.IsObject() && tab.HasMember("n") && tab["n"].IsString()) ? tab["n"].GetString() : "UNKNOWN_NAME";
+}
+
+static std::string TabUid(const rapidjson::Value &tab) {
+    return (tab.IsObject() && tab.HasMember("id") && tab["id"].IsString()) ? tab["id"].GetString() : "UNKNOWN_ID";
+}
+
+class ParseJob : public QRunnable {
+public:
+    ParseJob(TabParser *parser, int request_id, const QByteArray &bytes, const ItemLocation &location,
+             const std::shared_ptr<ParsedReply> &snapshot, int tab_index = -1) :
+        parser_(parser),
+        request_id_(request_id),
+        bytes_(bytes),
+        location_(location),
+        snapshot_(snapshot),
+        tab_index_(tab_index)
+    {}
+    void run() {
+        // The first tab of an update only learns its name from the tab list it comes with
+        if (tab_index_ >= 0) {
+            ParsedReply tabs;
+            StashReplyReader(bytes_, ItemLocation()).ReadTabList(&tabs);
+            location_ = TabParser::FindTab(tabs.tabs, tab_index_);
+        }
+
+        QByteArray fingerprint = TabParser::Fingerprint(bytes_, location_);
+        std::shared_ptr<ParsedReply> result;
+        if (snapshot_ && snapshot_->fingerprint == fingerprint) {
+            QLOG_DEBUG() << "Reply for" << location_.GetHeader().c_str() << "didn't change, reusing items";
+            result = std::make_shared<ParsedReply>(*snapshot_);
+            result->reused = true;
+        } else {
+            result = std::make_shared<ParsedReply>();
+            result->location = location_;
+            result->fingerprint = fingerprint;
+            StashReplyReader reader(bytes_, location_);
+            reader.Read(result.get());
+        }
+        result->request_id = request_id_;
+        // Items share the reply now, it's freed along with the last of them
+        bytes_.clear();
+        parser_->Finished(result);
+    }
+private:
+    TabParser *parser_;
+    int request_id_;
+    QByteArray bytes_;
+    ItemLocation location_;
+    // last good result for the location, reused if the reply didn't change since
+    std::shared_ptr<ParsedReply> snapshot_;
+    int tab_index_;
+};
+
+class StoredParseJob : public QRunnable {
+public:
+    StoredParseJob(TabParser *parser, int id, const QByteArray &bytes, int begin, int end) :
+        parser_(parser),
+        id_(id),
+        bytes_(bytes),
+        begin_(begin),
+        end_(end)
+    {}
+    void run() {
+        auto result = std::make_shared<ParsedReply>();
+        result->request_id = id_;
+        StashReplyReader reader(bytes_, ItemLocation());
+        result->valid = reader.ReadStored(&result->items, begin_, end_);
+        emit parser_->StoredParseFinished(result);
+    }
+private:
+    TabParser *parser_;
+    int id_;
+    QByteArray bytes_;
+    int begin_, end_;
+};
+
+TabParser::TabParser(QObject *parent) :
+    QObject(parent)
+{
+    pool_.setMaxThreadCount(std::max(QThread::idealThreadCount(), 1));
+}
+
+TabParser::~TabParser() {
+    pool_.waitForDone();
+}
+
+void TabParser::Parse(int request_id, const QByteArray &bytes, const ItemLocation &location) {
+    auto it = snapshots_.find(location);
+    std::shared_ptr<ParsedReply> snapshot = it != snapshots_.end() ? it->second : nullptr;
+    ++pending_;
+    pool_.start(new ParseJob(this, request_id, bytes, location, snapshot));
+}
+
+void TabParser::ParseFirstTab(int request_id, const QByteArray &bytes, int tab_index) {
+    ++pending_;
+    pool_.start(new ParseJob(this, request_id, bytes, ItemLocation(), nullptr, tab_index));
+}
+
+ItemLocation TabParser::FindTab(const std::string &tabs, int tab_index) {
+    rapidjson::Document doc;
+    if (doc.Parse(tabs.c_str()).HasParseError() || !doc.IsArray())
+        return ItemLocation();
+    for (auto &tab : doc) {
+        if (tab.IsObject() && tab.HasMember("i") && tab["i"].IsInt() && tab["i"].GetInt() == tab_index)
+            return ItemLocation(tab_index, TabName(tab), ItemLocationType::STASH);
+    }
+    return ItemLocation();
+}
+
+void TabParser::ParseStored(int id, const QByteArray &bytes, int begin, int end) {
+    pool_.start(new StoredParseJob(this, id, bytes, begin, end));
+}
+
+void TabParser::Remember(const std::shared_ptr<ParsedReply> &result) {
+    snapshots_[result->location] = result;
+}
+
+void TabParser::Forget(const ItemLocation &location) {
+    snapshots_.erase(location);
+}
+
+void TabParser::Seed(const ItemLocation &location, const QByteArray &fingerprint, const Items &items) {
+    auto result = std::make_shared<ParsedReply>();
+    result->location = location;
+    result->valid = true;
+    result->items = items;
+    result->fingerprint = fingerprint;
+    snapshots_[location] = result;
+}
+
+QByteArray TabParser::Fingerprint(const QByteArray &bytes, const ItemLocation &location) {
+    // Items carry their tab name, so the same reply for a renamed tab is different content
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(location.GetHeader().c_str());
+    hash.addData(bytes);
+    return hash.result();
+}
+
+bool TabParser::Full() const {
+    return pending_ >= kParseQueueDepth * pool_.maxThreadCount();
+}
+
+void TabParser::Finished(const std::shared_ptr<ParsedReply> &result) {
+    --pending_;
+    emit ParseFinished(result);
+}
+
+void TabParser::ParseItems(rapidjson::Value *value_ptr, const ItemLocation &base_location, rapidjson_allocator &alloc, Items *items,
+                           const std::shared_ptr<ItemArena> &arena) {
+    auto &value = *value_ptr;
+    for (auto &item : value) {
+        ItemLocation location(base_location);
+        location.FromItemJson(item);
+        location.ToItemJson(&item, alloc);
+        items->push_back(std::make_shared<Item>(item, arena));
+        location.set_socketed(true);
+        if (item.HasMember("socketedItems") && item["socketedItems"].IsArray())
+            ParseItems(&item["socketedItems"], location, alloc, items, arena);
+    }
+}
+
+TabsSignature TabParser::CreateTabsSignature(const rapidjson::Value &tabs) {
+    TabsSignature signature;
+    for (auto &tab : tabs)
+        signature.emplace_back(TabName(tab), TabUid(tab));
+    return signature;
+}
+
+TabHashes TabParser::CreateTabHashes(const rapidjson::Value &tabs) {
+    TabHashes hashes;
+    for (auto &tab : tabs)
+        hashes.push_back(TabHash(tab));
+    return hashes;
+}
+
+quint64 TabParser::TabHash(const rapidjson::Value &tab) {
+    return TabHash(TabName(tab), TabUid(tab));
+}
+
+quint64 TabParser::TabHash(const std::string &name, const std::string &uid) {
+    // 64 bit FNV-1a, the separator keeps ("ab", "c") and ("a", "bc") apart
+    quint64 hash = 14695981039346656037ULL;
+    auto add = [&hash](unsigned char c) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    };
+    for (unsigned char c : name)
+        add(c);
+    add(0);
+    for (unsigned char c : uid)
+        add(c);
+    return hash;
+}
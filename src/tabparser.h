@@ -0,0 +1,111 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "item.h"
+#include "itemlocation.h"
+#include "rapidjson_util.h"
+
+typedef std::vector<std::pair<std::string, std::string>> TabsSignature;
+// One hash of <"n", "id"> per tab, cheap to compare for the tab being fetched
+typedef std::vector<quint64> TabHashes;
+
+// Result of parsing a stash tab or character reply
+struct ParsedReply {
+    int request_id{0};
+    ItemLocation location;
+    // false if the reply was not a JSON object at all
+    bool valid{false};
+    // serialized "error" member if the server returned one instead of items
+    std::string error;
+    bool has_tabs{false};
+    // hash of <"n", "id"> of every tab in the "tabs" member
+    TabHashes tab_hashes;
+    // the "tabs" member as received, needed to resync when tabs were changed in game
+    std::string tabs;
+    Items items;
+    // Identifies the reply contents together with the location they were parsed for
+    QByteArray fingerprint;
+    // true if the result was reused from an earlier identical reply instead of parsed
+    bool reused{false};
+};
+
+/*
+ * Parses replies and constructs Items on a bounded thread pool so that the
+ * thread servicing the network is never stuck behind a large tab.
+ * ParseFinished is emitted from the pool thread, connect to it with a queued
+ * connection.
+ */
+class TabParser : public QObject {
+    Q_OBJECT
+public:
+    explicit TabParser(QObject *parent = nullptr);
+    ~TabParser();
+    // Parses bytes on the pool unless the last remembered reply for the location was identical,
+    // which is also found out on the pool
+    void Parse(int request_id, const QByteArray &bytes, const ItemLocation &location);
+    // Same for the reply that brings the tab list.  Its location is the tab at tab_index of that list,
+    // the result has an invalid location if there's no such tab.
+    void ParseFirstTab(int request_id, const QByteArray &bytes, int tab_index);
+    // Keeps the result so that identical replies for its location can skip parsing
+    void Remember(const std::shared_ptr<ParsedReply> &result);
+    void Forget(const ItemLocation &location);
+    // Same as Remember for items that were parsed in an earlier session from a reply with this fingerprint
+    void Seed(const ItemLocation &location, const QByteArray &fingerprint, const Items &items);
+    // Builds the items ItemsManagerWorker stored between offsets begin and end of bytes, see
+    // StashReplyReader::ReadStored.  id is passed on as the request_id of the result.
+    void ParseStored(int id, const QByteArray &bytes, int begin, int end);
+    // Number of replies submitted but not parsed yet
+    int pending() const { return pending_; }
+    // True if callers should hold off on producing more replies
+    bool Full() const;
+
+    // Items are allocated from arena if there is one, see ItemArena
+    static void ParseItems(rapidjson::Value *value_ptr, const ItemLocation &base_location, rapidjson_allocator &alloc, Items *items,
+                           const std::shared_ptr<ItemArena> &arena = nullptr);
+    static TabsSignature CreateTabsSignature(const rapidjson::Value &tabs);
+    static TabHashes CreateTabHashes(const rapidjson::Value &tabs);
+    static quint64 TabHash(const rapidjson::Value &tab);
+    static quint64 TabHash(const std::string &name, const std::string &uid);
+    // Location of the tab at tab_index of a "tabs" member, invalid if it's not there
+    static ItemLocation FindTab(const std::string &tabs, int tab_index);
+signals:
+    void ParseFinished(std::shared_ptr<ParsedReply> result);
+    void StoredParseFinished(std::shared_ptr<ParsedReply> result);
+private:
+    friend class ParseJob;
+    void Finished(const std::shared_ptr<ParsedReply> &result);
+
+    static QByteArray Fingerprint(const QByteArray &bytes, const ItemLocation &location);
+
+    QThreadPool pool_;
+    std::atomic<int> pending_{0};
+    // Last good result for every location, only used from the thread calling Parse
+    std::map<ItemLocation, std::shared_ptr<ParsedReply>> snapshots_;
+};
@@ -0,0 +1,260 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mockpoeserver.h"
+
+#include <QCryptographicHash>
+#include <QTcpSocket>
+#include <QUrl>
+#include <memory>
+
+namespace {
+
+// Stash tabs are 12x12, wrap generated items around so coordinates stay valid
+const int kStashWidth = 12;
+
+std::string Quote(const std::string &value) {
+    return "\"" + value + "\"";
+}
+
+}
+
+MockPoeServer::MockPoeServer(const std::string &league, int tabs, int items_per_tab, int characters, int items_per_character) :
+    league_(league),
+    items_per_tab_(items_per_tab),
+    items_per_character_(items_per_character)
+{
+    for (int i = 0; i < tabs; ++i) {
+        std::string id = QCryptographicHash::hash(QByteArray::number(i), QCryptographicHash::Sha1).toHex().toStdString();
+        tabs_.push_back({ "Tab " + std::to_string(i + 1), id, 0 });
+    }
+    for (int i = 0; i < characters; ++i)
+        characters_.push_back("Character" + std::to_string(i));
+
+    clock_.start();
+    server_.listen(QHostAddress::LocalHost);
+    QObject::connect(&server_, &QTcpServer::newConnection, [this]() {
+        while (server_.hasPendingConnections())
+            Serve(server_.nextPendingConnection());
+    });
+}
+
+std::string MockPoeServer::root() const {
+    return "http://127.0.0.1:" + std::to_string(server_.serverPort());
+}
+
+void MockPoeServer::SetRateLimit(int max_hits, int period, int penalty) {
+    max_hits_ = max_hits;
+    period_ = period;
+    penalty_ = penalty;
+}
+
+void MockPoeServer::AddLeague(const std::string &league) {
+    for (size_t i = 0; i < characters_.size(); ++i)
+        other_characters_.push_back({ league + "Character" + std::to_string(i), league });
+}
+
+void MockPoeServer::RenameTabAfter(int requests, int tab, const std::string &name) {
+    mutations_.push_back({ requests, tab, tab, name });
+}
+
+void MockPoeServer::MoveTabAfter(int requests, int from, int to) {
+    mutations_.push_back({ requests, from, to, "" });
+}
+
+void MockPoeServer::ChangeTab(int tab) {
+    ++tabs_[tab].generation;
+}
+
+int MockPoeServer::total_items() const {
+    return static_cast<int>(tabs_.size()) * items_per_tab_ + static_cast<int>(characters_.size()) * items_per_character_;
+}
+
+void MockPoeServer::Serve(QTcpSocket *socket) {
+    auto buffer = std::make_shared<QByteArray>();
+    QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    QObject::connect(socket, &QTcpSocket::readyRead, [this, socket, buffer]() {
+        buffer->append(socket->readAll());
+        if (!buffer->contains("\r\n\r\n"))
+            return;
+        // "GET /character-window/get-stash-items?league=... HTTP/1.1"
+        QList<QByteArray> request_line = buffer->left(buffer->indexOf("\r\n")).split(' ');
+        Response response{ 400, "{}", 0, true };
+        if (request_line.size() == 3) {
+            QUrl url(QString::fromUtf8(request_line[1]));
+            response = Handle(url.path().toStdString(), QUrlQuery(url));
+        }
+        socket->write(Reply(response));
+        socket->disconnectFromHost();
+    });
+}
+
+MockPoeServer::Response MockPoeServer::Handle(const std::string &path, const QUrlQuery &query) {
+    if (path == "/")
+        return { 200, MainPage(), 0, true };
+    if (path == "/character-window/get-characters")
+        return { 200, Characters(), 0, true };
+
+    bool stash = path == "/character-window/get-stash-items";
+    if (!stash && path != "/character-window/get-items")
+        return { 404, "{}", 0, true };
+
+    if (Limited(stash ? &stash_budget_ : &character_budget_)) {
+        ++rejected_;
+        return { 429, "{\"error\":{\"code\":3,\"message\":\"Rate limit exceeded\"}}", penalty_, stash };
+    }
+    if (!stash) {
+        ++character_requests_;
+        stash_requests_before_characters_ = stash_requests_;
+        return { 200, CharacterItems(query.queryItemValue("character").toStdString()), 0, false };
+    }
+
+    ++stash_requests_;
+    ApplyMutations();
+    if (fail_every_ > 0 && stash_requests_ % fail_every_ == 0) {
+        ++errors_;
+        return { 200, "{\"error\":{\"code\":1,\"message\":\"Resource not found\"}}", 0, true };
+    }
+    return { 200, StashItems(query.queryItemValue("tabIndex").toInt(), query.queryItemValue("tabs") == "1"), 0, true };
+}
+
+bool MockPoeServer::Limited(Budget *budget) {
+    if (max_hits_ <= 0)
+        return false;
+    qint64 now = clock_.elapsed();
+    if (now < budget->restricted_until)
+        return true;
+    auto &hits = budget->hits;
+    while (!hits.empty() && hits.front() + period_ * 1000 <= now)
+        hits.pop_front();
+    hits.push_back(now);
+    if (static_cast<int>(hits.size()) <= max_hits_)
+        return false;
+    budget->restricted_until = now + penalty_ * 1000;
+    return true;
+}
+
+void MockPoeServer::ApplyMutations() {
+    for (auto it = mutations_.begin(); it != mutations_.end();) {
+        if (it->after > stash_requests_) {
+            ++it;
+            continue;
+        }
+        if (it->from == it->to) {
+            tabs_[it->from].name = it->name;
+        } else {
+            Tab tab = tabs_[it->from];
+            tabs_.erase(tabs_.begin() + it->from);
+            tabs_.insert(tabs_.begin() + it->to, tab);
+        }
+        it = mutations_.erase(it);
+    }
+}
+
+QByteArray MockPoeServer::Reply(const Response &response) const {
+    QByteArray reply = "HTTP/1.1 " + QByteArray::number(response.status)
+        + (response.status == 200 ? " OK" : " Error") + "\r\n";
+    reply += "Content-Type: application/json\r\n";
+    // Same caching headers as the real thing, TabCache has to ignore them
+    reply += "Cache-Control: no-store, no-cache, must-revalidate\r\nPragma: no-cache\r\n";
+    if (max_hits_ > 0) {
+        const Budget &budget = response.stash ? stash_budget_ : character_budget_;
+        reply += response.stash ? "X-Rate-Limit-Policy: mock-request-limit\r\n" : "X-Rate-Limit-Policy: mock-character-request-limit\r\n";
+        reply += "X-Rate-Limit-Rules: Account\r\n";
+        reply += QString("X-Rate-Limit-Account: %1:%2:%3\r\n").arg(max_hits_).arg(period_).arg(penalty_).toUtf8();
+        reply += QString("X-Rate-Limit-Account-State: %1:%2:%3\r\n")
+            .arg(budget.hits.size()).arg(period_).arg(response.retry_after).toUtf8();
+    }
+    if (response.retry_after > 0)
+        reply += "Retry-After: " + QByteArray::number(response.retry_after) + "\r\n";
+    reply += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\nConnection: close\r\n\r\n";
+    reply += response.body;
+    return reply;
+}
+
+QByteArray MockPoeServer::MainPage() const {
+    if (characters_.empty())
+        return "<html></html>";
+    std::string page = "<html><script>var data = {\"activeCharacter\":{\"name\":\"" + characters_[0]
+        + "\",\"league\":\"" + league_ + "\"}};</script></html>";
+    return QByteArray::fromStdString(page);
+}
+
+QByteArray MockPoeServer::Characters() const {
+    std::vector<std::pair<std::string, std::string>> characters;
+    for (auto &name : characters_)
+        characters.push_back({ name, league_ });
+    characters.insert(characters.end(), other_characters_.begin(), other_characters_.end());
+
+    std::string json = "[";
+    for (auto &character : characters) {
+        if (json.size() > 1)
+            json += ",";
+        json += "{\"name\":" + Quote(character.first) + ",\"league\":" + Quote(character.second)
+            + ",\"classId\":1,\"class\":\"Marauder\",\"level\":90}";
+    }
+    return QByteArray::fromStdString(json + "]");
+}
+
+QByteArray MockPoeServer::CharacterItems(const std::string &name) const {
+    std::string json = "{\"items\":[";
+    for (int i = 0; i < items_per_character_; ++i) {
+        if (i > 0)
+            json += ",";
+        json += GenerateItem(name + "/" + std::to_string(i), "MainInventory", i % kStashWidth, i / kStashWidth);
+    }
+    json += "],\"character\":{\"name\":" + Quote(name) + ",\"league\":" + Quote(league_) + "}}";
+    return QByteArray::fromStdString(json);
+}
+
+QByteArray MockPoeServer::StashItems(int index, bool tabs) const {
+    if (index < 0 || index >= static_cast<int>(tabs_.size()))
+        return "{\"error\":{\"code\":1,\"message\":\"Resource not found\"}}";
+
+    const Tab &tab = tabs_[index];
+    std::string json = "{\"numTabs\":" + std::to_string(tabs_.size());
+    if (tabs) {
+        json += ",\"tabs\":[";
+        for (size_t i = 0; i < tabs_.size(); ++i) {
+            if (i > 0)
+                json += ",";
+            json += "{\"n\":" + Quote(tabs_[i].name) + ",\"i\":" + std::to_string(i) + ",\"id\":" + Quote(tabs_[i].id)
+                + ",\"type\":\"NormalStash\",\"hidden\":false,\"colour\":{\"r\":124,\"g\":84,\"b\":54}}";
+        }
+        json += "]";
+    }
+    json += ",\"items\":[";
+    for (int i = 0; i < items_per_tab_; ++i) {
+        if (i > 0)
+            json += ",";
+        std::string seed = tab.id + "/" + std::to_string(tab.generation) + "/" + std::to_string(i);
+        json += GenerateItem(seed, "Stash" + std::to_string(index + 1), i % kStashWidth, (i / kStashWidth) % kStashWidth);
+    }
+    return QByteArray::fromStdString(json + "]}");
+}
+
+std::string MockPoeServer::GenerateItem(const std::string &seed, const std::string &inventory, int x, int y) const {
+    std::string id = QCryptographicHash::hash(QByteArray::fromStdString(seed), QCryptographicHash::Sha256).toHex().toStdString();
+    return "{\"verified\":false,\"w\":1,\"h\":1,\"ilvl\":80,\"icon\":\"http://127.0.0.1/" + id.substr(0, 8) + ".png\""
+        ",\"league\":" + Quote(league_) + ",\"id\":" + Quote(id) + ",\"name\":" + Quote("Mock " + id.substr(0, 12))
+        + ",\"typeLine\":\"Coral Ring\",\"identified\":true,\"corrupted\":false,\"frameType\":2"
+        ",\"implicitMods\":[\"+25 to maximum Life\"],\"explicitMods\":[\"+" + std::to_string(seed.size() % 40 + 10)
+        + "% to Fire Resistance\"],\"x\":" + std::to_string(x) + ",\"y\":" + std::to_string(y)
+        + ",\"inventoryId\":" + Quote(inventory) + ",\"socketedItems\":[]}";
+}
@@ -0,0 +1,119 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QTcpServer>
+#include <QUrlQuery>
+#include <deque>
+#include <string>
+#include <vector>
+
+class QTcpSocket;
+
+/*
+ * Stand-in for the parts of pathofexile.com that ItemsManagerWorker talks to:
+ * the main page, get-characters, get-items and get-stash-items.
+ *
+ * It serves a synthetic account with a number of stash tabs and characters, each
+ * holding a fixed number of generated items.  On top of that it can enforce a rate
+ * limit (advertised with the same headers as the real API, stash tabs and character
+ * inventories are counted separately like they are there), answer some requests
+ * with an 'error' object and rename or move tabs after a number of stash requests
+ * to mimic a user playing while an update is running.
+ *
+ * Point the worker to it with ItemsManagerWorker::SetApiRoot(server.root()).
+ */
+class MockPoeServer {
+public:
+    MockPoeServer(const std::string &league, int tabs, int items_per_tab, int characters = 2, int items_per_character = 10);
+    std::string root() const;
+
+    void SetRateLimit(int max_hits, int period, int penalty);
+    // Lists a second set of characters playing in another league of the same account
+    void AddLeague(const std::string &league);
+    // Every n-th stash request gets {"error": ...} instead of the tab, 0 disables
+    void FailEvery(int n) { fail_every_ = n; }
+    // Renames the given tab once that many stash requests were served
+    void RenameTabAfter(int requests, int tab, const std::string &name);
+    // Moves a tab to another position once that many stash requests were served
+    void MoveTabAfter(int requests, int from, int to);
+    // Replaces the items of a tab with a new set, as if the user moved things around
+    void ChangeTab(int tab);
+
+    // Number of items a full update should end up with
+    int total_items() const;
+    int stash_requests() const { return stash_requests_; }
+    int character_requests() const { return character_requests_; }
+    // How many stash requests were served by the time the last character request came in
+    int stash_requests_before_characters() const { return stash_requests_before_characters_; }
+    int rejected() const { return rejected_; }
+    int errors() const { return errors_; }
+private:
+    struct Tab {
+        std::string name;
+        std::string id;
+        int generation;
+    };
+    struct Mutation {
+        int after;
+        int from;
+        int to;
+        std::string name;
+    };
+    struct Response {
+        int status;
+        QByteArray body;
+        int retry_after;
+        bool stash;
+    };
+    // Requests seen and restriction for either endpoint
+    struct Budget {
+        std::deque<qint64> hits;
+        qint64 restricted_until{0};
+    };
+
+    void Serve(QTcpSocket *socket);
+    Response Handle(const std::string &path, const QUrlQuery &query);
+    bool Limited(Budget *budget);
+    void ApplyMutations();
+    QByteArray Reply(const Response &response) const;
+    QByteArray MainPage() const;
+    QByteArray Characters() const;
+    QByteArray CharacterItems(const std::string &name) const;
+    QByteArray StashItems(int index, bool tabs) const;
+    std::string GenerateItem(const std::string &seed, const std::string &inventory, int x, int y) const;
+
+    QTcpServer server_;
+    QElapsedTimer clock_;
+    std::string league_;
+    std::vector<Tab> tabs_;
+    std::vector<std::string> characters_;
+    // <name, league> of characters outside of league_
+    std::vector<std::pair<std::string, std::string>> other_characters_;
+    int items_per_tab_, items_per_character_;
+    std::vector<Mutation> mutations_;
+    int max_hits_{0}, period_{1}, penalty_{0};
+    Budget stash_budget_, character_budget_;
+    int fail_every_{0};
+    int stash_requests_{0}, character_requests_{0}, rejected_{0}, errors_{0};
+    int stash_requests_before_characters_{0};
+};
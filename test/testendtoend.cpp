@@ -0,0 +1,285 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testendtoend.h"
+
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+
+#include "application.h"
+#include "buyoutmanager.h"
+#include "datastore.h"
+#include "filesystem.h"
+#include "itemsmanager.h"
+#include "itemsmanagerworker.h"
+#include "mainwindow.h"
+#include "mockpoeserver.h"
+#include "porting.h"
+
+namespace {
+
+const char *kLeague = "MockLeague";
+const char *kDefaultApiRoot = "https://www.pathofexile.com";
+
+// Logs in with memory data stores, which also starts the first update
+class Session {
+public:
+    Session() :
+        Session(true)
+    {}
+    // Without mock data everything is kept in the user directory, like a real login
+    explicit Session(bool mock_data) :
+        app_(std::make_unique<Application>())
+    {
+        app_->InitLogin(std::make_unique<QNetworkAccessManager>(), kLeague, "mockuser", mock_data);
+        Watch();
+    }
+    // Takes over an application that is already logged in, e.g. from Application::OpenLeague
+    explicit Session(std::unique_ptr<Application> app) :
+        app_(std::move(app))
+    {
+        Watch();
+    }
+    // Waits until that many updates have finished, gives up early if one is cancelled
+    bool WaitForUpdates(int count, int timeout) {
+        QElapsedTimer timer;
+        timer.start();
+        while (updates_ < count && !cancelled_ && timer.elapsed() < timeout)
+            QTest::qWait(10);
+        return updates_ >= count;
+    }
+    Application &app() { return *app_; }
+    int updates() const { return updates_; }
+    bool cancelled() const { return cancelled_; }
+private:
+    void Watch() {
+        QObject::connect(&app_->items_manager(), &ItemsManager::ItemsRefreshed, [this](bool initial_refresh) {
+            if (!initial_refresh)
+                ++updates_;
+        });
+        QObject::connect(&app_->items_manager(), &ItemsManager::StatusUpdate, [this](const CurrentStatusUpdate &status) {
+            if (status.state == ProgramState::UpdateCancelled)
+                cancelled_ = true;
+        });
+    }
+
+    std::unique_ptr<Application> app_;
+    int updates_{0};
+    bool cancelled_{false};
+};
+
+}
+
+void TestEndToEnd::init() {
+    old_user_dir_ = Filesystem::UserDir();
+    user_dir_ = std::make_unique<QTemporaryDir>();
+    Filesystem::SetUserDir(user_dir_->path().toStdString());
+}
+
+void TestEndToEnd::cleanup() {
+    ItemsManagerWorker::SetApiRoot(kDefaultApiRoot);
+    Filesystem::SetUserDir(old_user_dir_);
+    user_dir_.reset();
+}
+
+void TestEndToEnd::FullUpdate() {
+    MockPoeServer server(kLeague, tabs_, items_per_tab_);
+    server.SetRateLimit(30, 1, 2);
+    ItemsManagerWorker::SetApiRoot(server.root());
+
+    QElapsedTimer timer;
+    timer.start();
+    Session session;
+    QVERIFY(session.WaitForUpdates(1, 30000 + tabs_ * 200));
+
+    qDebug() << "Updated" << tabs_ << "tabs with" << server.total_items() << "items in" << timer.elapsed() << "ms";
+    QCOMPARE(static_cast<int>(session.app().items_manager().items().size()), server.total_items());
+    // Every tab and the tab list once more at the end
+    QCOMPARE(server.stash_requests(), tabs_ + 1);
+    // Everything was paced according to the advertised limit
+    QCOMPARE(server.rejected(), 0);
+}
+
+void TestEndToEnd::RecoversFromErrorReplies() {
+    MockPoeServer server(kLeague, 10, 5);
+    server.SetRateLimit(30, 1, 2);
+    server.FailEvery(4);
+    ItemsManagerWorker::SetApiRoot(server.root());
+
+    Session session;
+    QVERIFY(session.WaitForUpdates(1, 30000));
+
+    QVERIFY(server.errors() > 0);
+    QCOMPARE(server.stash_requests(), 10 + 1 + server.errors());
+    QCOMPARE(static_cast<int>(session.app().items_manager().items().size()), server.total_items());
+}
+
+void TestEndToEnd::ResyncsOnTabRename() {
+    MockPoeServer server(kLeague, 20, 5);
+    server.SetRateLimit(20, 1, 2);
+    server.RenameTabAfter(4, 10, "Renamed in game");
+    ItemsManagerWorker::SetApiRoot(server.root());
+
+    Session session;
+    QVERIFY(session.WaitForUpdates(1, 30000));
+    QVERIFY(!session.cancelled());
+
+    // Only the renamed tab and the reply that noticed had to be fetched again
+    QVERIFY(server.stash_requests() <= 20 + 3);
+    int renamed = 0;
+    for (auto &item : session.app().items_manager().items())
+        if (item->location().get_tab_label() == "Renamed in game")
+            ++renamed;
+    QCOMPARE(renamed, 5);
+    QCOMPARE(static_cast<int>(session.app().items_manager().items().size()), server.total_items());
+}
+
+void TestEndToEnd::ResyncsOnTabMove() {
+    MockPoeServer server(kLeague, 20, 5);
+    server.SetRateLimit(20, 1, 2);
+    server.MoveTabAfter(4, 0, 19);
+    ItemsManagerWorker::SetApiRoot(server.root());
+
+    Session session;
+    QVERIFY(session.WaitForUpdates(1, 30000));
+    QVERIFY(!session.cancelled());
+    // Every index changed, at most the tabs that were done already are fetched twice
+    QVERIFY(server.stash_requests() < 40);
+    QCOMPARE(static_cast<int>(session.app().items_manager().items().size()), server.total_items());
+}
+
+void TestEndToEnd::CachedTabsAreNotRefetched() {
+    MockPoeServer server(kLeague, 10, 5);
+    server.SetRateLimit(30, 1, 2);
+    ItemsManagerWorker::SetApiRoot(server.root());
+
+    Session session;
+    QVERIFY(session.WaitForUpdates(1, 30000));
+    QCOMPARE(server.stash_requests(), 11);
+
+    // Nothing is checked for refresh, so only the tab list is requested, at the start and the end
+    auto &bo = session.app().buyout_manager();
+    for (auto &tab : bo.GetStashTabLocations())
+        bo.SetRefreshChecked(tab, false);
+    session.app().items_manager().Update(TabSelection::Checked);
+    QVERIFY(session.WaitForUpdates(2, 30000));
+
+    QCOMPARE(server.stash_requests(), 13);
+    QCOMPARE(static_cast<int>(session.app().items_manager().items().size()), server.total_items());
+}
+
+void TestEndToEnd::UnchangedTabsSurviveRestart() {
+    MockPoeServer server(kLeague, 10, 5);
+    server.SetRateLimit(30, 1, 2);
+    ItemsManagerWorker::SetApiRoot(server.root());
+
+    {
+        Session first(false);
+        QVERIFY(first.WaitForUpdates(1, 30000));
+        // One row for every tab and both characters
+        QCOMPARE(static_cast<int>(first.app().data().GetLocations().size()), 12);
+    }
+    server.ChangeTab(3);
+
+    Session second(false);
+    // Stored items arrive location by location before the initial refresh
+    int loaded = 0, refreshed = 0;
+    bool initial_refresh = false;
+    QObject::connect(&second.app().items_manager(), &ItemsManager::ItemsRefreshed, [&initial_refresh](bool initial) {
+        initial_refresh = initial_refresh || initial;
+    });
+    QObject::connect(&second.app().items_manager(), &ItemsManager::LocationRefreshed, [&]() {
+        ++(initial_refresh ? refreshed : loaded);
+    });
+    QVERIFY(second.WaitForUpdates(1, 30000));
+
+    // Every tab and both characters
+    QCOMPARE(loaded, 12);
+    // The first tab brings the tab list and is always parsed, the rest keeps the items loaded at startup
+    QCOMPARE(refreshed, 2);
+    QCOMPARE(static_cast<int>(second.app().items_manager().items().size()), server.total_items());
+    QVERIFY(!second.app().items_manager().stale(ItemLocation(3, "Tab 4")));
+}
+
+void TestEndToEnd::MalformedLocationIsFetchedAgain() {
+    MockPoeServer server(kLeague, 10, 5);
+    server.SetRateLimit(30, 1, 2);
+    ItemsManagerWorker::SetApiRoot(server.root());
+    std::string key = ItemLocation(3, "Tab 4").GetHeader();
+
+    {
+        Session first(false);
+        QVERIFY(first.WaitForUpdates(1, 30000));
+        QVERIFY(first.app().data().SetLocations({ { key, "[{\"broken", "fingerprint" } }, {}));
+    }
+
+    Session second(false);
+    int loaded = 0;
+    bool initial_refresh = false;
+    QObject::connect(&second.app().items_manager(), &ItemsManager::ItemsRefreshed, [&initial_refresh](bool initial) {
+        initial_refresh = initial_refresh || initial;
+    });
+    QObject::connect(&second.app().items_manager(), &ItemsManager::LocationRefreshed, [&]() {
+        if (!initial_refresh)
+            ++loaded;
+    });
+    QVERIFY(second.WaitForUpdates(1, 30000));
+
+    // Everything but the broken tab was loaded, the update brought it back and stored it again
+    QCOMPARE(loaded, 11);
+    QCOMPARE(static_cast<int>(second.app().items_manager().items().size()), server.total_items());
+    for (auto &location : second.app().data().GetLocations()) {
+        if (location.key == key)
+            QVERIFY(location.items != "[{\"broken");
+    }
+}
+
+void TestEndToEnd::LeaguesShareRateBudget() {
+    MockPoeServer server(kLeague, 15, 5);
+    server.SetRateLimit(10, 1, 5);
+    server.AddLeague("OtherLeague");
+    ItemsManagerWorker::SetApiRoot(server.root());
+
+    Session first;
+    Session second(first.app().OpenLeague("OtherLeague"));
+    QVERIFY(first.WaitForUpdates(1, 30000));
+    QVERIFY(second.WaitForUpdates(1, 30000));
+
+    // Both workers drew from one budget, so the server never had to turn one of them down
+    QCOMPARE(server.rejected(), 0);
+    QCOMPARE(server.stash_requests(), 2 * (15 + 1));
+    QCOMPARE(static_cast<int>(first.app().items_manager().items().size()), server.total_items());
+}
+
+void TestEndToEnd::CharactersDoNotWaitForTabs() {
+    MockPoeServer server(kLeague, 30, 5, 4);
+    server.SetRateLimit(10, 1, 2);
+    ItemsManagerWorker::SetApiRoot(server.root());
+
+    Session session;
+    QVERIFY(session.WaitForUpdates(1, 30000));
+    // Characters were done while the stash lane had barely started
+    QVERIFY(server.stash_requests_before_characters() < 5);
+    QCOMPARE(server.rejected(), 0);
+
+    // The active character was the last one fetched, nothing has to be done to keep it selected
+    QTest::qWait(500);
+    QCOMPARE(server.character_requests(), 4);
+    QCOMPARE(static_cast<int>(session.app().items_manager().items().size()), server.total_items());
+}
@@ -0,0 +1,52 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <QtTest/QtTest>
+#include <memory>
+
+// Runs whole updates against MockPoeServer
+class TestEndToEnd : public QObject
+{
+    Q_OBJECT
+public:
+    // Account size of FullUpdate, the load test target makes it much bigger
+    explicit TestEndToEnd(int tabs = 20, int items_per_tab = 30) :
+        tabs_(tabs),
+        items_per_tab_(items_per_tab)
+    {}
+private slots:
+    void init();
+    void cleanup();
+    void FullUpdate();
+    void RecoversFromErrorReplies();
+    void ResyncsOnTabRename();
+    void ResyncsOnTabMove();
+    void CachedTabsAreNotRefetched();
+    void UnchangedTabsSurviveRestart();
+    void MalformedLocationIsFetchedAgain();
+    void LeaguesShareRateBudget();
+    void CharactersDoNotWaitForTabs();
+private:
+    int tabs_, items_per_tab_;
+    std::string old_user_dir_;
+    std::unique_ptr<QTemporaryDir> user_dir_;
+};
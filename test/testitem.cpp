@@ -19,9 +19,11 @@
 
 #include "testitem.h"
 
+#include <cmath>
 #include "rapidjson/document.h"
 
 #include "item.h"
+#include "itemstore.h"
 #include "testdata.h"
 
 void TestItem::Parse() {
@@ -38,7 +40,114 @@ void TestItem::Parse() {
     QCOMPARE(item.sockets().w, 0);
 
     // the hash should be the same between different versions of Acquisition and OSes
-    QCOMPARE(item.hash().c_str(), "605d9f566bc4305f4fd425efbbbed6a6");
-    // This needs to match so that item hash migration is successful
-    QCOMPARE(item.old_hash().c_str(), "5f083f2f5ceb10ed720bd4c1771ed09d");
+    QCOMPARE(item.hash().ToHex().c_str(), "ce682033a3b9c1108a471e61b0ebfa3d");
+    // These need to match so that item hash migration is successful
+    std::string old_hash, hash;
+    Item::LegacyHashes(doc, &old_hash, &hash);
+    QCOMPARE(hash.c_str(), "605d9f566bc4305f4fd425efbbbed6a6");
+    QCOMPARE(old_hash.c_str(), "5f083f2f5ceb10ed720bd4c1771ed09d");
+}
+
+void TestItem::InternsText() {
+    rapidjson::Document doc;
+    doc.Parse(kItem1.c_str());
+
+    Item first(doc), second(doc);
+    // Both items refer to the same copy of text that repeats across items
+    QCOMPARE(&first.icon(), &second.icon());
+    QCOMPARE(&first.type_line().str(), &second.type_line().str());
+    QCOMPARE(&first.category(), &second.category());
+    QVERIFY(!first.text_properties().empty());
+    QCOMPARE(&first.text_properties()[0].name.str(), &second.text_properties()[0].name.str());
+    QVERIFY(first.type_line() == InternedString(first.typeLine()));
+    QVERIFY(first.type_line() != InternedString("Scroll of Wisdom"));
+    // Mods and values are nearly unique to an item, the pool would only grow with them
+    auto &mods = first.text_mods("explicitMods");
+    QVERIFY(!mods.empty());
+    QCOMPARE(mods[0], second.text_mods("explicitMods")[0]);
+    QVERIFY(&mods[0] != &second.text_mods("explicitMods")[0]);
+}
+
+void TestItem::ContainersShareArena() {
+    rapidjson::Document doc;
+    doc.Parse(kItem1.c_str());
+    auto arena = std::make_shared<ItemArena>();
+    Item item(doc, arena), other(doc, arena);
+
+    QVERIFY(item.text_properties().get_allocator().arena() == arena.get());
+    QVERIFY(!item.text_properties().empty());
+    QVERIFY(item.text_properties()[0].values.get_allocator().arena() == arena.get());
+    QVERIFY(item.text_mods("explicitMods").get_allocator().arena() == arena.get());
+    QVERIFY(other.properties().get_allocator().arena() == arena.get());
+    QVERIFY(Item(doc).properties().get_allocator().arena() == nullptr);
+
+    // A copy can outlive the arena, it has to be on the heap
+    auto original = std::make_shared<Item>(doc, std::make_shared<ItemArena>());
+    Item copy(*original);
+    original.reset();
+    QVERIFY(copy.text_properties().get_allocator().arena() == nullptr);
+    QVERIFY(copy.text_properties()[0].values.get_allocator().arena() == nullptr);
+    QCOMPARE(copy.text_properties().size(), item.text_properties().size());
+    QCOMPARE(copy.text_mods("explicitMods").size(), item.text_mods("explicitMods").size());
+}
+
+void TestItem::ParsesNumericProperties() {
+    rapidjson::Document doc;
+    doc.Parse(kItem1.c_str());
+    Item armour(doc);
+
+    auto quality = armour.property("Quality");
+    QVERIFY(quality != nullptr);
+    QCOMPARE(quality->text.c_str(), "+20%");
+    QVERIFY(quality->numeric);
+    QCOMPARE(quality->min, 20.0);
+    QCOMPARE(armour.property("Armour")->min, 310.0);
+    QVERIFY(armour.property("Attacks per Second") == nullptr);
+    QCOMPARE(armour.DPS(), 0.0);
+
+    doc.Parse("{\"name\":\"\",\"typeLine\":\"Siege Axe\",\"properties\":["
+        "{\"name\":\"Physical Damage\",\"values\":[[\"10-20\",1]],\"displayMode\":0},"
+        "{\"name\":\"Elemental Damage\",\"values\":[[\"5-15\",4],[\"1-3\",5]],\"displayMode\":0},"
+        "{\"name\":\"Critical Strike Chance\",\"values\":[[\"5.00%\",0]],\"displayMode\":0},"
+        "{\"name\":\"Attacks per Second\",\"values\":[[\"1.50\",1]],\"displayMode\":0}]}");
+    Item weapon(doc);
+
+    auto damage = weapon.property("Physical Damage");
+    QCOMPARE(damage->min, 10.0);
+    QCOMPARE(damage->max, 20.0);
+    QCOMPARE(weapon.property("Critical Strike Chance")->min, 5.0);
+    QCOMPARE(weapon.pDPS(), 22.5);
+    QCOMPARE(weapon.eDPS(), 18.0);
+    QCOMPARE(weapon.DPS(), 40.5);
+}
+
+void TestItem::StoreColumns() {
+    rapidjson::Document doc;
+    doc.Parse(kItem1.c_str());
+    ItemLocation second(1, "Second"), first(0, "First");
+    Items items = {
+        std::make_shared<Item>(doc),
+        std::make_shared<Item>("Ring", second),
+        std::make_shared<Item>("Amulet", first),
+        std::make_shared<Item>("Belt", second),
+    };
+    ItemStore store(items);
+
+    QCOMPARE(store.size(), static_cast<size_t>(4));
+    QVERIFY(store.item(2) == items[2]);
+    QCOMPARE(store.sockets_g()[0], static_cast<uint8_t>(1));
+    QCOMPARE(store.hashes()[1], items[1]->hash());
+
+    auto &armour = store.property("Armour");
+    QCOMPARE(armour[0], 310.0);
+    QVERIFY(std::isnan(armour[1]));
+    // Built once, later lookups get the same column
+    QVERIFY(&store.property("Armour") == &armour);
+
+    // Locations are numbered in ItemLocation order, rows of the same location share the id
+    auto &ids = store.location_ids();
+    QCOMPARE(store.locations()[ids[2]].GetHeader().c_str(), first.GetHeader().c_str());
+    QCOMPARE(ids[1], ids[3]);
+    QVERIFY(ids[2] < ids[1]);
+    QCOMPARE(store.category_ids()[1], store.category_ids()[2]);
 }
@@ -26,4 +26,8 @@ class TestItem : public QObject
     Q_OBJECT
 private slots:
     void Parse();
+    void InternsText();
+    void ParsesNumericProperties();
+    void ContainersShareArena();
+    void StoreColumns();
 };
@@ -219,3 +219,73 @@ void TestItemsManager::ItemHashMigration() {
     auto buyout_from_mgr = bo.Get(item);
     QVERIFY2(buyout_from_mgr == buyout, "After migration: the buyout must match our data");
 }
+
+// Checks that buyouts keyed by the MD5 hash of db_version 2 move to the new hash
+void TestItemsManager::Md5HashMigration() {
+    rapidjson::Document doc;
+    doc.Parse(kItem1.c_str());
+
+    Item item(doc);
+
+    auto &bo = app_.buyout_manager();
+    auto buyout = Buyout(4.5, BUYOUT_TYPE_FIXED, CURRENCY_CHAOS_ORB, QDateTime::fromTime_t(890));
+    app_.data().Set("buyouts", "{\"605d9f566bc4305f4fd425efbbbed6a6\": {\"currency\": \"chaos\", \"type\": \"price\", \"value\": 4.5, \"last_update\": 890}}");
+    app_.data().SetInt("db_version", 2);
+    bo.Load();
+
+    QVERIFY2(!bo.Get(item).IsActive(), "Before migration: the buyout should exist but be inactive");
+    app_.items_manager().OnItemsRefreshed({ std::make_shared<Item>(item) }, {}, true);
+
+    QVERIFY2(bo.Get(item) == buyout, "After migration: the buyout must match our data");
+    QCOMPARE(app_.data().GetInt("db_version"), 3);
+}
+
+// Checks that legacy keys stay until a complete load, items showing up later are migrated then
+void TestItemsManager::MigrationAfterIncompleteLoad() {
+    rapidjson::Document doc;
+    doc.Parse(kItem1.c_str());
+
+    auto item = std::make_shared<Item>(doc);
+
+    auto &bo = app_.buyout_manager();
+    auto buyout = Buyout(4.5, BUYOUT_TYPE_FIXED, CURRENCY_CHAOS_ORB, QDateTime::fromTime_t(890));
+    app_.data().Set("buyouts", "{\"605d9f566bc4305f4fd425efbbbed6a6\": {\"currency\": \"chaos\", \"type\": \"price\", \"value\": 4.5, \"last_update\": 890}}");
+    app_.data().SetInt("db_version", 2);
+    bo.Load();
+
+    // The item's location didn't load
+    app_.items_manager().OnItemsRefreshed({}, {}, true, false);
+    QCOMPARE(app_.data().GetInt("db_version"), 2);
+
+    app_.items_manager().OnLocationRefreshed(item->location(), { item });
+    QVERIFY2(bo.Get(*item) == buyout, "After migration: the buyout must match our data");
+    QCOMPARE(app_.data().GetInt("db_version"), 2);
+
+    app_.items_manager().OnItemsRefreshed({ item }, {}, true, true);
+    QVERIFY2(bo.Get(*item) == buyout, "After migration: the buyout must match our data");
+    QCOMPARE(app_.data().GetInt("db_version"), 3);
+}
+
+// Checks that a per-location refresh only replaces items of that location
+void TestItemsManager::LocationRefreshReplacesItems() {
+    ItemLocation first_tab(1, "first");
+    ItemLocation second_tab(2, "second");
+    auto first = std::make_shared<Item>("First item", first_tab);
+    auto second = std::make_shared<Item>("Second item", second_tab);
+    auto replacement = std::make_shared<Item>("Replacement item", first_tab);
+
+    auto &bo = app_.buyout_manager();
+    Buyout tab_buyout(456.0, BUYOUT_TYPE_BUYOUT, CURRENCY_CHAOS_ORB, QDateTime::currentDateTime());
+    bo.SetTab(first_tab.GetUniqueHash(), tab_buyout);
+
+    auto tabs = { first_tab, second_tab };
+    app_.items_manager().OnItemsRefreshed({ first, second }, tabs, true);
+    app_.items_manager().OnLocationRefreshed(first_tab, { replacement });
+
+    auto &items = app_.items_manager().items();
+    QCOMPARE(items.size(), static_cast<size_t>(2));
+    QVERIFY2(std::find(items.begin(), items.end(), first) == items.end(), "Old item of the refreshed tab must be gone");
+    QVERIFY2(std::find(items.begin(), items.end(), second) != items.end(), "Items of other tabs must be kept");
+    QVERIFY2(std::find(items.begin(), items.end(), replacement) != items.end(), "New item must be added");
+    QVERIFY2(bo.Get(*replacement).IsActive(), "New item must inherit the tab buyout");
+}
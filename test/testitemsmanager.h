@@ -36,6 +36,9 @@ private slots:
     void MoveItemBoToNoBo();
     void MoveItemBoToBo();
     void ItemHashMigration();
+    void Md5HashMigration();
+    void MigrationAfterIncompleteLoad();
+    void LocationRefreshReplacesItems();
 private:
     Application app_;
 };
@@ -4,9 +4,13 @@
 #include <memory>
 
 #include "porting.h"
+#include "testendtoend.h"
 #include "testitem.h"
 #include "testitemsmanager.h"
+#include "testratelimiter.h"
 #include "testshop.h"
+#include "teststashreplyreader.h"
+#include "testtabcache.h"
 #include "testutil.h"
 
 #define TEST(Class) result |= QTest::qExec(std::make_unique<Class>().get())
@@ -21,6 +25,18 @@ int test_main() {
     TEST(TestShop);
     TEST(TestUtil);
     TEST(TestItemsManager);
+    TEST(TestRateLimiter);
+    TEST(TestEndToEnd);
+    TEST(TestStashReplyReader);
+    TEST(TestTabCache);
 
     return result != 0 ? -1 : 0;
 }
+
+int load_test_main(int tabs, int items_per_tab) {
+    QLocale::setDefault(QLocale::C);
+    std::setlocale(LC_ALL, "C");
+
+    TestEndToEnd test(tabs, items_per_tab);
+    return QTest::qExec(&test, QStringList() << "acquisition" << "FullUpdate") != 0 ? -1 : 0;
+}
@@ -1,3 +1,5 @@
 #pragma once
 
-int test_main();
\ No newline at end of file
+int test_main();
+// Runs a full update of a mock account with that many tabs and items against a local server
+int load_test_main(int tabs, int items_per_tab);
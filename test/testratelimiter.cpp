@@ -0,0 +1,170 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testratelimiter.h"
+
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <deque>
+#include <memory>
+
+#include "ratelimiter.h"
+
+namespace {
+
+// Minimal HTTP server that enforces a single rate limit window and advertises
+// it with the same headers as the real API.
+class RateLimitedServer {
+public:
+    RateLimitedServer(int max_hits, int period, int penalty) :
+        max_hits_(max_hits),
+        period_(period),
+        penalty_(penalty)
+    {
+        clock_.start();
+        server_.listen(QHostAddress::LocalHost);
+        QObject::connect(&server_, &QTcpServer::newConnection, [this]() {
+            while (server_.hasPendingConnections())
+                Serve(server_.nextPendingConnection());
+        });
+    }
+    QUrl url() const {
+        return QUrl(QString("http://127.0.0.1:%1/character-window/get-stash-items").arg(server_.serverPort()));
+    }
+    int rejected() const { return rejected_; }
+private:
+    void Serve(QTcpSocket *socket) {
+        auto buffer = std::make_shared<QByteArray>();
+        QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        QObject::connect(socket, &QTcpSocket::readyRead, [this, socket, buffer]() {
+            buffer->append(socket->readAll());
+            if (!buffer->contains("\r\n\r\n"))
+                return;
+            socket->write(Reply());
+            socket->disconnectFromHost();
+        });
+    }
+    QByteArray Reply() {
+        qint64 now = clock_.elapsed();
+        while (!hits_.empty() && hits_.front() + period_ * 1000 <= now)
+            hits_.pop_front();
+        hits_.push_back(now);
+        bool limited = static_cast<int>(hits_.size()) > max_hits_;
+        if (limited)
+            ++rejected_;
+
+        QByteArray reply = limited ? "HTTP/1.1 429 Too Many Requests\r\n" : "HTTP/1.1 200 OK\r\n";
+        reply += "Content-Type: application/json\r\n";
+        reply += "X-Rate-Limit-Policy: stub-limit\r\n";
+        reply += "X-Rate-Limit-Rules: Account\r\n";
+        reply += QString("X-Rate-Limit-Account: %1:%2:%3\r\n").arg(max_hits_).arg(period_).arg(penalty_).toUtf8();
+        reply += QString("X-Rate-Limit-Account-State: %1:%2:%3\r\n")
+            .arg(hits_.size()).arg(period_).arg(limited ? penalty_ : 0).toUtf8();
+        if (limited)
+            reply += QString("Retry-After: %1\r\n").arg(penalty_).toUtf8();
+        reply += "Content-Length: 2\r\nConnection: close\r\n\r\n{}";
+        return reply;
+    }
+
+    QTcpServer server_;
+    QElapsedTimer clock_;
+    std::deque<qint64> hits_;
+    int max_hits_, period_, penalty_;
+    int rejected_{0};
+};
+
+std::unique_ptr<QNetworkReply> Get(QNetworkAccessManager &nm, const QUrl &url) {
+    std::unique_ptr<QNetworkReply> reply(nm.get(QNetworkRequest(url)));
+    QSignalSpy spy(reply.get(), SIGNAL(finished()));
+    if (!reply->isFinished())
+        spy.wait(5000);
+    return reply;
+}
+
+}
+
+void TestRateLimiter::LearnsPolicyFromHeaders() {
+    RateLimitedServer server(3, 2, 5);
+    QNetworkAccessManager nm;
+    RateLimiter limiter;
+
+    QVERIFY(limiter.TryAcquire());
+    auto reply = Get(nm, server.url());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    limiter.Update(reply.get());
+
+    QCOMPARE(limiter.policy(), std::string("stub-limit"));
+    // 3 requests per 2 seconds means the next one has to be paced instead of sent right away
+    QVERIFY(!limiter.TryAcquire());
+    int wait = limiter.MsecsUntilNextRequest();
+    QVERIFY(wait > 0);
+    QVERIFY(wait <= 2000 + kThrottleMarginMsecs);
+    QVERIFY(!limiter.IsThrottled());
+}
+
+void TestRateLimiter::PacesRequestsWithinBudget() {
+    RateLimitedServer server(3, 1, 5);
+    QNetworkAccessManager nm;
+    RateLimiter limiter;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < 7; ++i) {
+        while (!limiter.TryAcquire())
+            QTest::qWait(limiter.MsecsUntilNextRequest());
+        auto reply = Get(nm, server.url());
+        limiter.Update(reply.get());
+    }
+
+    QCOMPARE(server.rejected(), 0);
+    // 7 requests don't fit into a couple of 1 second windows
+    QVERIFY(timer.elapsed() >= 2000);
+}
+
+void TestRateLimiter::BacksOffOnTooManyRequests() {
+    RateLimitedServer server(1, 10, 3);
+    QNetworkAccessManager nm;
+    RateLimiter limiter;
+
+    // Bypass the limiter to get ourselves rejected
+    Get(nm, server.url());
+    auto reply = Get(nm, server.url());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 429);
+    limiter.Update(reply.get());
+
+    QVERIFY(limiter.IsThrottled());
+    QVERIFY(!limiter.TryAcquire());
+    QVERIFY(limiter.MsecsUntilNextRequest() > 2000);
+}
+
+void TestRateLimiter::SharedPerAccount() {
+    auto first = RateLimiter::ForAccount("first");
+    QCOMPARE(RateLimiter::ForAccount("first"), first);
+    QVERIFY(RateLimiter::ForAccount("second") != first);
+    QVERIFY(RateLimiter::ForAccount("first", "characters") != first);
+
+    // What one worker spends is gone for every other worker of the account
+    auto other = RateLimiter::ForAccount("first");
+    while (first->TryAcquire()) {}
+    QVERIFY(!other->TryAcquire());
+    QVERIFY(other->MsecsUntilNextRequest() > 0);
+}
@@ -0,0 +1,146 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "teststashreplyreader.h"
+
+#include "rapidjson/document.h"
+
+#include "item.h"
+#include "stashreplyreader.h"
+#include "tabparser.h"
+
+namespace {
+
+const char *kReply =
+    "{\"numTabs\": 2, \"tabs\": [{\"n\":\"First \\\"tab\\\"\",\"i\":0,\"id\":\"a1\"},{\"n\":\"Second\",\"i\":1,\"id\":\"b2\"}],\n"
+    " \"items\": [\n"
+    "  {\"w\":1,\"h\":1,\"name\":\"Vermillion Loop\",\"typeLine\":\"Ruby Ring\",\"frameType\":2,\"x\":3,\"y\":4,"
+    "\"inventoryId\":\"Stash1\",\"explicitMods\":[\"+30% to Fire Resistance\",\"Caf\\u00e9\"],\"socketedItems\":[]},\n"
+    "  {\"w\":2,\"h\":3,\"name\":\"\",\"typeLine\":\"Vaal Regalia\",\"frameType\":0,\"x\":0,\"y\":0,\"inventoryId\":\"Stash1\","
+    "\"sockets\":[{\"group\":0,\"attr\":\"I\"}],\"socketedItems\":[{\"w\":1,\"h\":1,\"typeLine\":\"Arc\",\"support\":false,"
+    "\"frameType\":4,\"socket\":0,\"colour\":\"I\"}]}\n"
+    " ]}";
+
+}
+
+void TestStashReplyReader::MatchesDocumentParse() {
+    ItemLocation location(1, "First \"tab\"", ItemLocationType::STASH);
+    QByteArray bytes(kReply);
+    ParsedReply reply;
+    StashReplyReader reader(bytes, location);
+    QVERIFY(reader.Read(&reply));
+    QVERIFY(reply.has_tabs);
+    QCOMPARE(reply.tab_hashes.size(), static_cast<size_t>(2));
+    QCOMPARE(reply.tab_hashes[0], TabParser::TabHash("First \"tab\"", "a1"));
+    QVERIFY(reply.tab_hashes[0] != TabParser::TabHash("First \"tab\"", "b2"));
+
+    rapidjson::Document doc;
+    doc.Parse(kReply);
+    Items expected;
+    TabParser::ParseItems(&doc["items"], location, doc.GetAllocator(), &expected);
+
+    QCOMPARE(reply.items.size(), expected.size());
+    QCOMPARE(reply.items.size(), static_cast<size_t>(3));
+    // Socketed items too, the reply's items are freed together
+    ItemArena *arena = reply.items[0]->properties().get_allocator().arena();
+    QVERIFY(arena != nullptr);
+    for (auto &item : reply.items)
+        QVERIFY(item->properties().get_allocator().arena() == arena);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        QCOMPARE(reply.items[i]->hash(), expected[i]->hash());
+        QCOMPARE(reply.items[i]->location().GetHeader(), expected[i]->location().GetHeader());
+        QCOMPARE(reply.items[i]->location().socketed(), expected[i]->location().socketed());
+        // Text differs (whitespace, escapes) but has to describe the same item
+        rapidjson::Document read, parsed;
+        read.Parse(reply.items[i]->json().str().c_str());
+        parsed.Parse(expected[i]->json().str().c_str());
+        QVERIFY(!read.HasParseError());
+        QVERIFY(read == parsed);
+    }
+}
+
+void TestStashReplyReader::ErrorAndMalformedReplies() {
+    ItemLocation location(0, "tab", ItemLocationType::STASH);
+
+    QByteArray error("{\"error\":{\"code\":1,\"message\":\"Resource not found\"}}");
+    ParsedReply error_reply;
+    QVERIFY(StashReplyReader(error, location).Read(&error_reply));
+    QVERIFY(!error_reply.error.empty());
+    QVERIFY(error_reply.items.empty());
+
+    // Cut off in the middle of an item
+    QByteArray truncated = QByteArray(kReply).left(300);
+    ParsedReply truncated_reply;
+    QVERIFY(!StashReplyReader(truncated, location).Read(&truncated_reply));
+    QVERIFY(!truncated_reply.valid);
+    QVERIFY(truncated_reply.items.empty());
+
+    QByteArray not_object("[1, 2, 3]");
+    ParsedReply not_object_reply;
+    QVERIFY(!StashReplyReader(not_object, location).Read(&not_object_reply));
+}
+
+void TestStashReplyReader::ReadsStoredItems() {
+    ItemLocation location(1, "tab", ItemLocationType::STASH);
+    QByteArray bytes(kReply);
+    ParsedReply reply;
+    QVERIFY(StashReplyReader(bytes, location).Read(&reply));
+
+    // Same as ItemsManagerWorker stores them
+    std::string stored = "[";
+    for (auto &item : reply.items) {
+        if (stored.size() > 1)
+            stored += ",";
+        item->json().AppendTo(&stored);
+    }
+    stored += "]";
+
+    Items items;
+    QByteArray stored_bytes = QByteArray::fromStdString(stored);
+    QVERIFY(StashReplyReader(stored_bytes, ItemLocation()).ReadStored(&items));
+    QCOMPARE(items.size(), reply.items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        QCOMPARE(items[i]->hash(), reply.items[i]->hash());
+        QCOMPARE(items[i]->location().GetHeader(), reply.items[i]->location().GetHeader());
+        QCOMPARE(items[i]->json().str(), reply.items[i]->json().str());
+    }
+
+    // Everything but the first item, the way stored locations are read as a range
+    Items chunk;
+    int begin = 2 + static_cast<int>(reply.items[0]->json().size());
+    int end = stored_bytes.size() - 1;
+    QVERIFY(StashReplyReader(stored_bytes, ItemLocation()).ReadStored(&chunk, begin, end));
+    QCOMPARE(chunk.size(), reply.items.size() - 1);
+    QCOMPARE(chunk.back()->hash(), reply.items.back()->hash());
+    QVERIFY(!StashReplyReader(stored_bytes, ItemLocation()).ReadStored(&chunk, begin, stored_bytes.size() + 1));
+}
+
+void TestStashReplyReader::ReadsTabListOnly() {
+    ParsedReply reply;
+    QVERIFY(StashReplyReader(QByteArray(kReply), ItemLocation()).ReadTabList(&reply));
+    QVERIFY(reply.has_tabs);
+    QVERIFY(reply.items.empty());
+    QCOMPARE(reply.tab_hashes.size(), static_cast<size_t>(2));
+
+    ItemLocation second = TabParser::FindTab(reply.tabs, 1);
+    QVERIFY(second.IsValid());
+    QCOMPARE(second.GetHeader(), ItemLocation(1, "Second", ItemLocationType::STASH).GetHeader());
+    QVERIFY(!TabParser::FindTab(reply.tabs, 2).IsValid());
+}
@@ -0,0 +1,184 @@
+/*
+    Copyright 2014 Ilya Zhuravlev
+
+    This file is part of Acquisition.
+
+    Acquisition is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Acquisition is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Acquisition.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testtabcache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QNetworkCacheMetaData>
+#include <QTemporaryDir>
+#include <memory>
+
+#include "rapidjson/document.h"
+#include "tabcache.h"
+
+namespace {
+
+// Stores a reply the way QNetworkAccessManager does
+void Put(TabCache *cache, const QUrl &url, const QByteArray &payload) {
+    QNetworkCacheMetaData meta;
+    meta.setUrl(url);
+    meta.setSaveToDisk(true);
+    QIODevice *device = cache->prepare(meta);
+    QVERIFY(device);
+    device->write(payload);
+    cache->insert(device);
+}
+
+QByteArray Get(TabCache *cache, const QUrl &url) {
+    std::unique_ptr<QIODevice> device(cache->data(url));
+    return device ? device->readAll() : QByteArray();
+}
+
+QUrl TabUrl(int index) {
+    return QUrl(QString("http://127.0.0.1/character-window/get-stash-items?tabIndex=%1").arg(index));
+}
+
+}
+
+void TestTabCache::ServesRepeatedReadsFromMemory() {
+    QTemporaryDir dir;
+    {
+        TabCache cache;
+        cache.setCacheDirectory(dir.path());
+
+        Put(&cache, TabUrl(0), "{\"items\":[]}");
+        QVERIFY(cache.metaData(TabUrl(0)).isValid());
+        for (int i = 0; i < 3; ++i)
+            QCOMPARE(Get(&cache, TabUrl(0)), QByteArray("{\"items\":[]}"));
+        QCOMPARE(cache.memory_hits(), 3ll);
+        QCOMPARE(cache.memory_misses(), 0ll);
+    }
+
+    // A fresh cache on the same directory has to go to disk once, then it's in memory
+    TabCache reopened;
+    reopened.setCacheDirectory(dir.path());
+    QCOMPARE(Get(&reopened, TabUrl(0)), QByteArray("{\"items\":[]}"));
+    QCOMPARE(Get(&reopened, TabUrl(0)), QByteArray("{\"items\":[]}"));
+    QCOMPARE(reopened.memory_misses(), 1ll);
+    QCOMPARE(reopened.memory_hits(), 1ll);
+}
+
+void TestTabCache::EvictsLeastRecentlyUsed() {
+    QTemporaryDir dir;
+    TabCache cache;
+    cache.setCacheDirectory(dir.path());
+    cache.SetMemoryLimit(250);
+
+    QByteArray payload(100, 'x');
+    Put(&cache, TabUrl(0), payload);
+    Put(&cache, TabUrl(1), payload);
+    // Tab 0 is used again, so tab 1 is the one to go
+    Get(&cache, TabUrl(0));
+    Put(&cache, TabUrl(2), payload);
+    QCOMPARE(cache.memory_evictions(), 1ll);
+    QCOMPARE(cache.memory_size(), 200ll);
+
+    qint64 misses = cache.memory_misses();
+    Get(&cache, TabUrl(0));
+    QCOMPARE(cache.memory_misses(), misses);
+    // Still on disk
+    QCOMPARE(Get(&cache, TabUrl(1)), payload);
+    QCOMPARE(cache.memory_misses(), misses + 1);
+}
+
+void TestTabCache::RemoveDropsBothTiers() {
+    QTemporaryDir dir;
+    TabCache cache;
+    cache.setCacheDirectory(dir.path());
+
+    Put(&cache, TabUrl(0), "{}");
+    QVERIFY(cache.remove(TabUrl(0)));
+    QVERIFY(!cache.metaData(TabUrl(0)).isValid());
+    QVERIFY(cache.data(TabUrl(0)) == nullptr);
+    QCOMPARE(cache.memory_size(), 0ll);
+}
+
+void TestTabCache::StoresIdenticalRepliesOnce() {
+    QTemporaryDir dir;
+    QString objects = dir.path() + "/objects";
+    QByteArray payload;
+    for (int i = 0; i < 200; ++i)
+        payload += "{\"name\":\"Mock\",\"typeLine\":\"Coral Ring\",\"ilvl\":80},";
+
+    {
+        TabCache first, second;
+        first.SetObjectDirectory(objects);
+        first.setCacheDirectory(dir.path() + "/first/League");
+        second.SetObjectDirectory(objects);
+        second.setCacheDirectory(dir.path() + "/second/League");
+
+        Put(&first, TabUrl(0), payload);
+        Put(&second, TabUrl(3), payload);
+        QCOMPARE(QDir(objects).entryList(QDir::Files).size(), 1);
+        // Repetitive JSON compresses very well
+        QVERIFY(first.cacheSize() * 4 < payload.size());
+
+        // The other cache still needs the object
+        QVERIFY(first.remove(TabUrl(0)));
+        QCOMPARE(QDir(objects).entryList(QDir::Files).size(), 1);
+    }
+
+    TabCache reopened;
+    reopened.SetObjectDirectory(objects);
+    reopened.setCacheDirectory(dir.path() + "/second/League");
+    QCOMPARE(Get(&reopened, TabUrl(3)), payload);
+}
+
+void TestTabCache::ReportsStatistics() {
+    QTemporaryDir dir;
+    TabCache cache;
+    cache.setCacheDirectory(dir.path());
+
+    Put(&cache, TabUrl(0), "{\"items\":[]}");
+    Put(&cache, TabUrl(1), "{\"items\":[1]}");
+    // Last used times have millisecond resolution
+    QTest::qSleep(10);
+    cache.StartRefresh();
+    Get(&cache, TabUrl(0));
+    Get(&cache, TabUrl(0));
+
+    TabCacheStats stats = cache.Stats();
+    QCOMPARE(stats.entries, 2);
+    QCOMPARE(stats.size, cache.cacheSize());
+    QCOMPARE(stats.hits, 2ll);
+    QCOMPARE(stats.misses, 2ll);
+    QCOMPARE(stats.refresh_hits, 2ll);
+    QCOMPARE(stats.refresh_misses, 0ll);
+    QCOMPARE(stats.bytes_served, 2ll * 12);
+    qint64 objects_size = 0;
+    for (auto &info : QDir(dir.path() + "/objects").entryInfoList(QDir::Files))
+        objects_size += info.size();
+    QVERIFY(objects_size > 0);
+    QCOMPARE(stats.objects_size, objects_size);
+    // Most recently used first
+    QCOMPARE(cache.Snapshot().front().url, TabUrl(0));
+
+    QVERIFY(cache.Dump());
+    QFile file(dir.path() + "/tabcache.stats.json");
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    rapidjson::Document doc;
+    doc.Parse(file.readAll().constData());
+    QVERIFY(doc.IsObject());
+    QCOMPARE(doc["entries"].GetInt(), 2);
+    QCOMPARE(static_cast<int>(doc["contents"].Size()), 2);
+    // Both were used just now
+    QCOMPARE(doc["idle"][0]["entries"].GetInt(), 2);
+}